@@ -50,12 +50,30 @@ AVIF=true
 # Partial support for SVG load via resvg, enabled by default
 SVG=true
 
+# Let libwebp encode and decode with an extra worker thread, disabled by default.
+# libvips runs webpsave on a single thread, this overlaps its analysis and alpha
+# passes. Each encode and decode takes an extra thread from the pthread pool.
+# Toggling this requires a clean build/target directory.
+WEBP_THREADS=false
+
+# Let libaom and libheif encode and decode AVIF with worker threads, disabled by
+# default. The number of threads follows `vips.concurrency()`, which is 1 on the
+# web. Toggling this requires a clean build/target directory.
+AVIF_THREADS=false
+
 # Build libvips C++ API, disabled by default
 LIBVIPS_CPP=false
 
 # Build bindings, enabled by default but can be disabled if you only need libvips
 BINDINGS=true
 
+# Build the native benchmarks, disabled by default
+BENCHMARKS=false
+
+# Target 64-bit memory (wasm64) to process images beyond the 4 GiB heap limit,
+# disabled by default. This is a Node.js only build.
+MEMORY64=false
+
 # Parse arguments
 while [ $# -gt 0 ]; do
   case $1 in
@@ -65,18 +83,34 @@ while [ $# -gt 0 ]; do
     --disable-uhdr) UHDR=false ;;
     --disable-jxl) JXL=false ;;
     --disable-avif) AVIF=false ;;
+    --enable-webp-threads) WEBP_THREADS=true ;;
+    --enable-avif-threads) AVIF_THREADS=true ;;
     --disable-svg) SVG=false ;;
     --disable-modules) MODULES=false ;;
     --disable-bindings) BINDINGS=false ;;
     --enable-libvips-cpp) LIBVIPS_CPP=true ;;
+    --enable-benchmarks) BENCHMARKS=true ;;
+    --enable-memory64) MEMORY64=true ;;
     -e|--environment) ENVIRONMENT="$2"; shift ;;
     *) echo "ERROR: Unknown parameter: $1" >&2; exit 1 ;;
   esac
   shift
 done
 
+if [ "$MEMORY64" = "true" ]; then
+  # Keep the wasm64 dependencies apart from the wasm32 ones
+  TARGET=$SOURCE_DIR/build/target-wasm64
+  mkdir -p $TARGET
+  # Browsers don't ship memory64 by default yet
+  ENVIRONMENT="node"
+  # Link the loaders statically, the side modules in lib/ are wasm32 only
+  MODULES=false
+  # Rust has no wasm64-unknown-emscripten target
+  SVG=false
+fi
+
 # Configure the ENABLE_* and DISABLE_* expansion helpers
-for arg in UHDR JXL AVIF SVG MODULES BINDINGS; do
+for arg in UHDR JXL AVIF WEBP_THREADS AVIF_THREADS SVG MODULES BINDINGS; do
   if [ "${!arg}" = "true" ]; then
     declare ENABLE_$arg=true
   else
@@ -110,6 +144,9 @@ if [ "$LTO" = "true" ]; then
   COMMON_FLAGS+=" -flto"
   export RUSTFLAGS+=" -Clto -Cembed-bitcode=yes"
 fi
+if [ "$MEMORY64" = "true" ]; then
+  COMMON_FLAGS+=" -sMEMORY64"
+fi
 
 export CFLAGS="$COMMON_FLAGS -fvisibility=hidden -msimd128 -DWASM_SIMD_COMPAT_SLOW"
 export CXXFLAGS="$CFLAGS"
@@ -122,8 +159,13 @@ export PKG_CONFIG_PATH="$TARGET/lib/pkgconfig"
 export EM_PKG_CONFIG_PATH="$PKG_CONFIG_PATH"
 
 # Specific variables for cross-compilation
-export CHOST="wasm32-unknown-linux" # wasm32-unknown-emscripten
-export MESON_ARGS="--cross-file=$SOURCE_DIR/build/wasm32-emscripten.ini"
+if [ "$MEMORY64" = "true" ]; then
+  export CHOST="wasm64-unknown-linux" # wasm64-unknown-emscripten
+  export MESON_ARGS="--cross-file=$SOURCE_DIR/build/wasm64-emscripten.ini"
+else
+  export CHOST="wasm32-unknown-linux" # wasm32-unknown-emscripten
+  export MESON_ARGS="--cross-file=$SOURCE_DIR/build/wasm32-emscripten.ini"
+fi
 
 # Run as many parallel jobs as there are available CPU cores
 export MAKEFLAGS="-j$(nproc)"
@@ -406,7 +448,7 @@ node --version
     -DWEBP_BUILD_GIF2WEBP=OFF -DWEBP_BUILD_IMG2WEBP=OFF -DWEBP_BUILD_VWEBP=OFF \
     -DWEBP_BUILD_WEBPINFO=OFF -DWEBP_BUILD_WEBPMUX=OFF -DWEBP_BUILD_EXTRAS=OFF \
     -DCMAKE_C_FLAGS="$CFLAGS -U__AVX2__ -DWEBP_DISABLE_STATS -DWEBP_REDUCE_CSP" \
-    -DWEBP_USE_THREAD=OFF # Disable threading support, we rely on libvips' thread pool
+    -DWEBP_USE_THREAD=${ENABLE_WEBP_THREADS:+ON}${DISABLE_WEBP_THREADS:+OFF} # By default, we rely on libvips' thread pool
   make -C _build install
 )
 
@@ -450,7 +492,7 @@ node --version
     -DAOM_TARGET_CPU=generic ${ENABLE_MODULES:+-DCONFIG_PIC=1} -DCONFIG_RUNTIME_CPU_DETECT=0 \
     -DENABLE_DOCS=OFF -DENABLE_TESTS=OFF -DENABLE_EXAMPLES=OFF -DENABLE_TOOLS=OFF \
     -DCONFIG_WEBM_IO=0 -DCONFIG_AV1_HIGHBITDEPTH=1 \
-    -DCONFIG_MULTITHREAD=0 # Disable threading support, we rely on libvips' thread pool.
+    -DCONFIG_MULTITHREAD=${ENABLE_AVIF_THREADS:+1}${DISABLE_AVIF_THREADS:+0} # By default, we rely on libvips' thread pool.
   make -C _build install
 )
 
@@ -465,7 +507,7 @@ node --version
     -DBUILD_SHARED_LIBS=OFF -DENABLE_PLUGIN_LOADING=OFF -DBUILD_TESTING=OFF -DWITH_EXAMPLES=OFF \
     -DWITH_LIBDE265=OFF -DWITH_X265=OFF -DWITH_X264=OFF -DWITH_OpenH264_DECODER=OFF \
     -DCMAKE_C_FLAGS="$CFLAGS -O3" -DCMAKE_CXX_FLAGS="$CXXFLAGS -O3 -D__EMSCRIPTEN_STANDALONE_WASM__" \
-    -DENABLE_MULTITHREADING_SUPPORT=OFF # Disable threading support, we rely on libvips' thread pool.
+    -DENABLE_MULTITHREADING_SUPPORT=${ENABLE_AVIF_THREADS:+ON}${DISABLE_AVIF_THREADS:+OFF} # By default, we rely on libvips' thread pool.
   make -C _build install
   if [ -n "$ENABLE_MODULES" ]; then
     # Ensure we don't link with libsharpyuv in the vips-heif side module
@@ -485,6 +527,28 @@ node --version
   curl -Ls https://github.com/libvips/libvips/compare/v$VERSION_VIPS...kleisauke:wasm-vips-$VERSION_VIPS.patch | patch -p1
   # Disable building man pages, gettext po files, tools, and (fuzz-)tests
   sed -i "/subdir('man')/{N;N;N;N;d;}" meson.build
+  # Ask libwebp for a multi-threaded encode, decodes already set `use_threads`
+  if [ -n "$ENABLE_WEBP_THREADS" ]; then
+    sed -i '/WebPValidateConfig(&webp->config)/i webp->config.thread_level = 1;' libvips/foreign/webpsave.c
+    grep -B1 'WebPValidateConfig(&webp->config)' libvips/foreign/webpsave.c | grep -q 'webp->config.thread_level = 1;' ||
+      { echo "Unable to patch webpsave.c for --enable-webp-threads"; exit 1; }
+  fi
+  # Flush file targets in 64 KiB chunks rather than 8500 bytes, each flush is a write syscall that crosses into JS
+  # with NODERAWFS. Encoders such as libjpeg and libpng hand over a few KiB at a time.
+  sed -i '/#define VIPS_TARGET_BUFFER_SIZE/s/(8500)/(65536)/' libvips/include/vips/connection.h
+  grep -q 'VIPS_TARGET_BUFFER_SIZE (65536)' libvips/include/vips/connection.h || { echo "VIPS_TARGET_BUFFER_SIZE has moved"; exit 1; }
+  if [ -n "$ENABLE_AVIF_THREADS" ]; then
+    # Size the aom encoder and libheif decoder threads by the libvips concurrency, rather than by the number of
+    # cores, so that they never take more threads than the pthread pool has to offer. aom uses row-based
+    # multithreading within each tile by default.
+    sed -i '/error = heif_encoder_set_lossless(/i (void) heif_encoder_set_parameter_integer(heif->encoder, "threads", vips_concurrency_get());' libvips/foreign/heifsave.c
+    sed -i '/heif->ctx = heif_context_alloc();/a heif_context_set_max_decoding_threads(heif->ctx, vips_concurrency_get() > 1 ? vips_concurrency_get() : 0);' libvips/foreign/heifload.c
+    # Fail when the code above has moved
+    grep -q '"threads"' libvips/foreign/heifsave.c ||
+      { echo "Unable to patch heifsave.c for --enable-avif-threads"; exit 1; }
+    grep -q max_decoding_threads libvips/foreign/heifload.c ||
+      { echo "Unable to patch heifload.c for --enable-avif-threads"; exit 1; }
+  fi
   meson setup _build --prefix=$TARGET $MESON_ARGS --default-library=static --buildtype=release \
     -Ddeprecated=false -Dexamples=false -Dcplusplus=$LIBVIPS_CPP -Dauto_features=enabled \
     -Dintrospection=disabled ${DISABLE_MODULES:+-Dmodules=disabled} -Darchive=disabled \
@@ -505,10 +569,17 @@ node --version
   stage "Compiling JS bindings"
   cd $SOURCE_DIR
   meson setup $DEPS/wasm-vips --prefix=$TARGET $MESON_ARGS --buildtype=release --bindir="$SOURCE_DIR/lib" \
-    -Denvironments=$ENVIRONMENT -Dmodules=$MODULES -Dwasmfs=$WASM_FS
+    -Denvironments=$ENVIRONMENT -Dmodules=$MODULES -Dwasmfs=$WASM_FS -Dbenchmarks=$BENCHMARKS \
+    -Dmemory64=$MEMORY64
   meson install -C $DEPS/wasm-vips --tag runtime
 )
 
+[ -n "$DISABLE_BINDINGS" ] || [ "$MEMORY64" != "true" ] || (
+  # Prefer .mjs extension for the ES6 module of the wasm64 flavour
+  mv $SOURCE_DIR/lib/vips-node-wasm64-es6.js $SOURCE_DIR/lib/vips-node-wasm64.mjs
+  sed -i 's/vips-node-wasm64-es6.js/vips-node-wasm64.mjs/g' $SOURCE_DIR/lib/vips-node-wasm64.mjs
+)
+
 [ -n "$DISABLE_BINDINGS" ] || [ "$ENVIRONMENT" != "web,node" ] || (
   # Building for both Node.js and web, prepare NPM package
   stage "Prepare NPM package"
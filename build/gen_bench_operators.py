@@ -0,0 +1,153 @@
+#!/usr/bin/env python
+
+# This file generates the per-operator microbenchmarks for test/bench/suite.js
+
+# this needs pyvips
+#
+#   pip install --user pyvips
+import argparse
+
+from pyvips import Introspect, GValue, Error, \
+    ffi, enum_dict, gobject_lib, type_map, type_from_name, nickname_find
+
+# for VipsOperationFlags
+_OPERATION_DEPRECATED = 8
+
+# Values for required arguments, by argument name. Everything is run on
+# small images (see `makeContext()` in suite.js), so keep sizes small.
+arg_values = {
+    'width': '64',
+    'height': '64',
+    'size': '64',
+    'left': '0',
+    'top': '0',
+    'x': '0',
+    'y': '0',
+    'dx': '0',
+    'dy': '0',
+    'mask': 'ctx.mask',
+    'lut': 'ctx.lut',
+    'index': 'ctx.mono',
+    'matrix': '[1, 0, 0, 1]',
+    'coeff': '[1, 0, 0, 1]',
+    'bands': '1',
+    'exponent': '2.2',
+    'scale': '0.5',
+    'vscale': '0.5',
+    'hscale': '0.5',
+    'sigma': '1.5',
+    'angle': '45',
+    'radius': '4',
+}
+
+# Operations that can't be run in a loop with synthetic arguments.
+skip = [
+    # need files, sources or targets
+    'system', 'sink_screen', 'tilecache', 'linecache', 'sequential',
+    # need matching images of a specific shape
+    'mosaic', 'mosaic1', 'merge', 'match', 'globalbalance', 'matrixinvert',
+    # draw operations modify their input in place
+    'draw_circle', 'draw_flood', 'draw_image', 'draw_line', 'draw_mask',
+    'draw_rect', 'draw_smudge',
+]
+
+# turn a GType into a JS expression for a synthetic value, or None if we
+# can't make one
+def js_value(name, gtype):
+    if name in arg_values:
+        return arg_values[name]
+
+    fundamental = gobject_lib.g_type_fundamental(gtype)
+
+    if gtype == GValue.image_type:
+        return 'ctx.im'
+    if gtype == GValue.array_image_type:
+        return '[ctx.im, ctx.im]'
+    if gtype == GValue.array_double_type:
+        return '[1]'
+    if gtype == GValue.array_int_type:
+        return '[1]'
+    if gtype == GValue.gbool_type:
+        return 'true'
+    if gtype == GValue.gint_type:
+        return '1'
+    if gtype == GValue.gdouble_type:
+        return '1'
+    if fundamental == GValue.genum_type:
+        return f"'{next(iter(enum_dict(gtype)))}'"
+    if fundamental == GValue.gflags_type:
+        return '0'
+
+    # strings, blobs, sources, targets, interpolators ...
+    return None
+
+
+def to_camel_case(snake_str):
+    components = snake_str.split('_')
+    return components[0] + ''.join(x.title() for x in components[1:])
+
+
+def generate_case(operation_name):
+    intro = Introspect.get(operation_name)
+
+    args = []
+    for name in intro.method_args:
+        value = js_value(name, intro.details[name]['type'])
+        if value is None:
+            return None
+        args.append(value)
+
+    receiver = 'vips.Image' if intro.member_x is None else 'ctx.im'
+    js_name = to_camel_case(operation_name)
+
+    return f"  {{ name: '{operation_name}', fn: (vips, ctx) => " \
+           f"{receiver}.{js_name}({', '.join(args)}) }}"
+
+
+def generate_cases():
+    foreign = type_from_name('VipsForeign')
+    all_nicknames = []
+
+    def add_nickname(gtype, a, b):
+        nickname = nickname_find(gtype)
+        try:
+            # can fail for abstract types
+            intro = Introspect.get(nickname)
+
+            # we are only interested in non-deprecated, non-foreign
+            # operations
+            if (intro.flags & _OPERATION_DEPRECATED) == 0 and \
+                    not gobject_lib.g_type_is_a(gtype, foreign):
+                all_nicknames.append(nickname)
+        except Error:
+            pass
+
+        type_map(gtype, add_nickname)
+
+        return ffi.NULL
+
+    type_map(type_from_name('VipsOperation'), add_nickname)
+
+    all_nicknames = sorted(set(all_nicknames) - set(skip))
+
+    cases = []
+    for nickname in all_nicknames:
+        case = generate_case(nickname)
+        if case is not None:
+            cases.append(case)
+
+    return cases
+
+
+parser = argparse.ArgumentParser(description='Generate operator benchmarks.')
+parser.add_argument('-o', '--output', default='../test/bench/operators.js',
+                    help='output file')
+args = parser.parse_args()
+
+print(f'Generating {args.output}...')
+
+with open(args.output, 'w') as f:
+    f.write('// Auto-generated by build/gen_bench_operators.py, do not edit.\n')
+    f.write('export default [\n')
+    f.write(',\n'.join(generate_cases()))
+    f.write('\n];\n')
@@ -22,8 +22,8 @@ gtype_to_cpp = {
     GValue.gflags_type: 'int',
     GValue.genum_type: 'emscripten::val',
     GValue.image_type: 'emscripten::val',
-    GValue.array_int_type: 'const std::vector<int> &',
-    GValue.array_double_type: 'const std::vector<double> &',
+    GValue.array_int_type: 'emscripten::val',
+    GValue.array_double_type: 'emscripten::val',
     GValue.array_image_type: 'emscripten::val',
     GValue.blob_type: 'const std::string &',
     GValue.source_type: 'const Source &',
@@ -41,8 +41,8 @@ gtype_to_cpp_param = {
     GValue.image_type: 'emscripten::val',
     GValue.source_type: 'const Source &',
     GValue.target_type: 'const Target &',
-    GValue.array_int_type: 'const std::vector<int> &',
-    GValue.array_double_type: 'const std::vector<double> &',
+    GValue.array_int_type: 'emscripten::val',
+    GValue.array_double_type: 'emscripten::val',
     GValue.array_image_type: 'emscripten::val',
     GValue.blob_type: 'const std::string &'
 }
@@ -24,6 +24,14 @@ interface EmscriptenModule {
 
     // https://github.com/kleisauke/wasm-vips/issues/12
     workaroundCors: boolean;
+
+    INITIAL_MEMORY: number;
+
+    // The amount of memory the operation cache is sized against, defaults to the maximum heap size.
+    memoryCeiling: number;
+
+    // Set to false to keep temp files in memory, rather than in the origin private file system (OPFS).
+    opfsTmp: boolean;
 }
 
 declare namespace Vips {
@@ -42,7 +50,7 @@ declare namespace Vips {
         | Uint32Array
         | Float32Array
         | Float64Array;
-    type ArrayConstant = SingleOrArray<number>;
+    type ArrayConstant = SingleOrArray<number> | Float64Array | Int32Array;
     type ArrayImage = SingleOrArray<Image> | Vector<Image>;
     type DeletionFuncs<T extends EmbindClassHandle<T>> = EmbindClassHandle<T>[];
 
@@ -54,6 +62,42 @@ declare namespace Vips {
      */
     const deletionQueue: DeletionFuncs<Image | Connection | Interpolate>;
 
+    /**
+     * Run a function and delete every handle it made once it returns, except
+     * for its result and the handles in it, the elements of a returned array
+     * or the own properties of a returned object. This releases the memory held by intermediate images
+     * right away, rather than when the {@link deletionQueue} is flushed.
+     * ```js
+     * const thumbnail = vips.scope(() => {
+     *   const im = vips.Image.newFromBuffer(buffer);
+     *   return im.resize(0.5).sharpen().writeToBuffer('.jpg');
+     * });
+     * ```
+     * Handles that should outlive the scope can be kept with
+     * {@link EmbindClassHandle.preventAutoDelete}. Scopes can be nested. The
+     * function must be synchronous, a `TypeError` is thrown when it returns a
+     * promise or another thenable. Single handles can be released with
+     * `using` instead, see {@link EmbindClassHandle.[Symbol.dispose]}.
+     * @param fn The function to run.
+     * @return The result of `fn`.
+     */
+    function scope<T>(fn: () => T): T;
+
+    /**
+     * Whether this is the 64-bit memory (wasm64) flavour, which can address
+     * more than 4 GiB. This is a separate Node.js build, see `vips-node-wasm64.mjs`.
+     */
+    const memory64: boolean;
+
+    /**
+     * Whether temp files are kept in the origin private file system (OPFS). This is
+     * the case for WasmFS builds running in a worker on the web, unless the
+     * `opfsTmp` Module option is false. Temp files then spill to real storage,
+     * rather than memory. They go in a directory of their own, which is emptied on
+     * startup.
+     */
+    const opfsTmp: boolean;
+
     /**
      * Get the major, minor or patch version number of the libvips library.
      * When the flag is omitted, the entire version number is returned as a string.
@@ -220,6 +264,7 @@ declare namespace Vips {
     abstract class Cache {
         /**
          * Gets or, when a parameter is provided, sets the maximum number of operations libvips keeps in cache.
+         * Setting this disables the adaptive cache sizing, see {@link adaptive}.
          * @param max Maximum number of operations.
          * @return The maximum number of operations libvips keeps in cache.
          */
@@ -227,11 +272,32 @@ declare namespace Vips {
 
         /**
          * Gets or, when a parameter is provided, sets the maximum amount of tracked memory allowed.
+         * Setting this disables the adaptive cache sizing, see {@link adaptive}.
          * @param mem Maximum amount of tracked memory.
          * @return The maximum amount of tracked memory libvips allows.
          */
         static maxMem(mem?: number): undefined | number;
 
+        /**
+         * Gets or, when a parameter is provided, sets whether the maximum number of operations
+         * and the maximum amount of tracked memory are sized against the Wasm heap.
+         *
+         * The memory budget is a fifth of the current heap size. Once the tracked memory
+         * passes 75% of the {@link memoryCeiling}, the budget and the number of operations
+         * shrink linearly, down to nothing at the ceiling. They grow back gradually, with a
+         * half-life of 5 seconds, once the memory is released. This is enabled by default.
+         * @param adaptive Enable or disable the adaptive sizing.
+         * @return Whether the adaptive sizing is enabled.
+         */
+        static adaptive(adaptive?: boolean): undefined | boolean;
+
+        /**
+         * Get the amount of memory the cache is sized against. This is the maximum heap size,
+         * unless lowered with the `memoryCeiling` Module option.
+         * @return The memory ceiling in bytes.
+         */
+        static memoryCeiling(): number;
+
         /**
          * Gets or, when a parameter is provided, sets the maximum amount of tracked files allowed.
          * @param maxFiles Maximum amount of tracked files.
@@ -244,6 +310,245 @@ declare namespace Vips {
          * @return The current number of operations in cache.
          */
         static size(): number;
+
+        /**
+         * Get the statistics of the operation cache. The per-operation figures cover the
+         * operations called from JS; operations that libvips calls internally are only
+         * counted in `size` and `mem`.
+         * @return The statistics.
+         */
+        static stats(): CacheStats;
+
+        /**
+         * Drop operations from the operation cache.
+         * @param filter An operation nickname, a function that returns `true` for the
+         * entries to drop, or `undefined` to drop all operations called from JS.
+         * @return The number of dropped operations.
+         */
+        static drop(filter?: string | ((entry: CacheEntry) => boolean)): number;
+
+        /**
+         * Drop least-recently used operations until the amount of memory tracked by
+         * libvips, as reported by {@link Stats.mem}, is at most `bytes`, or the cache is
+         * empty. This is all tracked memory, including memory held by images outside the
+         * cache, which is also what {@link maxMem} is compared against. Handy to shed
+         * memory under pressure without disabling the cache.
+         * @param bytes The amount of tracked memory to trim to.
+         * @return The number of dropped operations.
+         */
+        static trimTrackedMem(bytes: number): number;
+
+        /**
+         * Gets or, when a parameter is provided, sets the maximum number of bytes of encoded
+         * results kept by the result cache. The result cache is disabled by default.
+         *
+         * While enabled, images made by operations remember how they were made, down to the
+         * content of the loaded buffer. Writing such an image to a buffer with the same
+         * suffix and options a second time returns the cached result. Enable the cache
+         * before loading the images you want to cache.
+         * @param mem Maximum number of bytes, or `0` to disable.
+         * @return The maximum number of bytes kept by the result cache.
+         */
+        static resultMaxMem(mem?: number): undefined | number;
+
+        /**
+         * Set a backing store for the result cache, or `null` to remove it. The store is
+         * consulted when a result isn't found in the cache, and is given every new result.
+         * It can be used to share results between instances, for example by keeping them
+         * in a `SharedArrayBuffer`.
+         * @param store The backing store.
+         */
+        static resultStore(store: ResultStore | null): void;
+
+        /**
+         * Get the statistics of the result cache.
+         * @return The statistics.
+         */
+        static resultStats(): ResultCacheStats;
+
+        /**
+         * Drop all results from the result cache and reset its statistics.
+         */
+        static resultClear(): void;
+
+        /**
+         * Gets or, when a parameter is provided, sets the directory of the decode cache, or
+         * `''` to disable it. The decode cache is disabled by default.
+         *
+         * While enabled, {@link Image.newFromFile} and {@link Image.newFromBuffer} hash the
+         * content of the file or buffer, together with the load options. The first load
+         * writes the decoded image as a vips-format (`.v`) file to this directory, later loads
+         * reopen that file instead of decoding the image again. The directory outlives the
+         * process, so on Node.js the cache is kept between runs and can be shared between
+         * processes. The directory is created if needed.
+         *
+         * Decoded images are large, a 24 megapixel RGB image takes 72 MB on disc. Use
+         * {@link decodeMaxSize} to cap the size of the directory.
+         * @param dir The directory.
+         * @return The directory of the decode cache.
+         */
+        static decodeDir(dir?: string): undefined | string;
+
+        /**
+         * Gets or, when a parameter is provided, sets the maximum number of bytes of decoded
+         * images kept on disc, defaults to 1 GiB. Least-recently used images are deleted
+         * first. The cap covers the whole directory, including images cached by other
+         * processes.
+         * @param size Maximum number of bytes.
+         * @return The maximum number of bytes kept by the decode cache.
+         */
+        static decodeMaxSize(size?: number): undefined | number;
+
+        /**
+         * Get the statistics of the decode cache.
+         * @return The statistics.
+         */
+        static decodeStats(): DecodeCacheStats;
+
+        /**
+         * Delete all decoded images from the decode cache directory and reset its statistics.
+         */
+        static decodeClear(): void;
+    }
+
+    /**
+     * Statistics of the operation cache.
+     */
+    interface CacheStats {
+        /**
+         * Number of bytes of tracked memory currently allocated.
+         */
+        mem: number;
+
+        /**
+         * Number of operations in cache.
+         */
+        size: number;
+
+        /**
+         * Number of cached operations, by operation nickname.
+         */
+        operations: { [nickname: string]: number };
+
+        /**
+         * Number of calls that reused a cached operation.
+         */
+        hits: number;
+
+        /**
+         * Number of calls that built a new operation.
+         */
+        misses: number;
+
+        /**
+         * Number of operations dropped from the cache. Operations that libvips never
+         * cached are not counted.
+         */
+        evictions: number;
+
+        /**
+         * Age in seconds of the oldest cached operation.
+         */
+        oldestAge: number;
+    }
+
+    /**
+     * An entry of the operation cache, as given to the {@link Cache.drop} filter.
+     */
+    interface CacheEntry {
+        /**
+         * The operation nickname, for example `'resize'`.
+         */
+        nickname: string;
+
+        /**
+         * Age in seconds.
+         */
+        age: number;
+
+        /**
+         * Number of times the operation was reused.
+         */
+        hits: number;
+    }
+
+    /**
+     * A backing store for the result cache, see {@link Cache.resultStore}.
+     */
+    interface ResultStore {
+        /**
+         * Get a result.
+         * @param key The key of the result.
+         * @return The result, or `undefined` if the store doesn't have it.
+         */
+        get(key: string): Uint8Array | undefined;
+
+        /**
+         * Store a result.
+         * @param key The key of the result.
+         * @param data The result, owned by the store.
+         */
+        set(key: string, data: Uint8Array): void;
+    }
+
+    /**
+     * Statistics of the result cache.
+     */
+    interface ResultCacheStats {
+        /**
+         * Number of cached results.
+         */
+        entries: number;
+
+        /**
+         * Number of bytes held by the cached results.
+         */
+        mem: number;
+
+        /**
+         * Number of lookups answered from the cache or the backing store.
+         */
+        hits: number;
+
+        /**
+         * Number of lookups that had to encode the image.
+         */
+        misses: number;
+
+        /**
+         * Number of results dropped to stay within the byte budget.
+         */
+        evictions: number;
+    }
+
+    /**
+     * Statistics of the decode cache.
+     */
+    interface DecodeCacheStats {
+        /**
+         * Number of decoded images on disc.
+         */
+        entries: number;
+
+        /**
+         * Number of bytes held by the decoded images.
+         */
+        size: number;
+
+        /**
+         * Number of loads that reopened a decoded image.
+         */
+        hits: number;
+
+        /**
+         * Number of loads that had to decode the image.
+         */
+        misses: number;
+
+        /**
+         * Number of decoded images deleted to stay within the size cap.
+         */
+        evictions: number;
     }
 
     /**
@@ -307,6 +612,84 @@ declare namespace Vips {
         static tempName(format: string): string;
     }
 
+    /**
+     * Statistics of the last {@link Scheduler.writeToBuffers} call.
+     */
+    interface SchedulerStats {
+        /**
+         * Number of images handled.
+         */
+        jobs: number;
+
+        /**
+         * Number of images evaluated concurrently, one per worker thread.
+         */
+        interImageJobs: number;
+
+        /**
+         * Number of images evaluated one after the other, each using libvips' own thread pool.
+         */
+        intraImageJobs: number;
+
+        /**
+         * Number of jobs waiting in the queue when the workers started.
+         */
+        queueDepth: number;
+
+        /**
+         * Number of worker threads used.
+         */
+        threads: number;
+
+        /**
+         * Fraction of the available worker time spent on evaluation, between `0` and `1`.
+         */
+        utilization: number;
+    }
+
+    /**
+     * Evaluate a set of independent pipelines.
+     *
+     * libvips parallelizes within a single image, but for small images the thread pool
+     * startup cost dominates. Images with at most `pixelThreshold` pixels are therefore
+     * evaluated concurrently, one per worker thread. Larger images are evaluated one after
+     * the other with the default concurrency. This happens off the calling thread, so it
+     * never blocks the main browser thread.
+     */
+    class Scheduler extends EmbindClassHandle<Scheduler> {
+        /**
+         * Make a new scheduler.
+         * @param threads Number of worker threads, defaults to a quarter of the available cores.
+         * @param pixelThreshold Images with at most this many pixels are evaluated concurrently.
+         */
+        constructor(threads?: number, pixelThreshold?: number);
+
+        /**
+         * Number of worker threads.
+         */
+        readonly threads: number;
+
+        /**
+         * Images with at most this many pixels are evaluated concurrently.
+         */
+        readonly pixelThreshold: number;
+
+        /**
+         * Write a set of images to formatted buffers. The results are returned in the same
+         * order as the input images.
+         * @param images The images to write.
+         * @param suffix The suffix, for example `'.jpg'`.
+         * @return A promise for the formatted buffers.
+         */
+        writeToBuffers(images: Image[], suffix: string): Promise<Uint8Array[]>;
+
+        /**
+         * Get the statistics of the last {@link writeToBuffers} call.
+         * @return The statistics.
+         */
+        stats(): SchedulerStats;
+    }
+
     /**
      * The abstract base Connection class.
      */
@@ -352,6 +735,91 @@ declare namespace Vips {
          * @return A new source.
          */
         static newFromMemory(memory: Blob): Source;
+
+        /**
+         * Make a new random access source from a function that fetches byte ranges.
+         *
+         * The source is read in blocks that are kept in an LRU, so that loaders of
+         * tiled formats only fetch the tiles they touch. Adjacent missing blocks are
+         * fetched with a single call. The function must return the bytes synchronously,
+         * for example with a synchronous `XMLHttpRequest` in a worker:
+         * ```js
+         * const source = vips.Source.newFromRanges((offset, length) => {
+         *   const xhr = new XMLHttpRequest();
+         *   xhr.open('GET', url, false);
+         *   xhr.responseType = 'arraybuffer';
+         *   xhr.setRequestHeader('Range', `bytes=${offset}-${offset + length - 1}`);
+         *   xhr.send();
+         *   return new Uint8Array(xhr.response);
+         * }, size);
+         * const thumb = vips.Image.thumbnailSource(source, 256);
+         * ```
+         * @param fetchRange Returns exactly `length` bytes from `offset`.
+         * @param size The size of the source in bytes.
+         * @param options Optional options.
+         * @return A new source.
+         */
+        static newFromRanges(fetchRange: (offset: number, length: number) => Uint8Array, size: number, options?: {
+            /**
+             * The size of a block in bytes, defaults to 256 KiB.
+             */
+            blockSize?: number
+            /**
+             * The memory budget of the block cache in bytes, defaults to 64 MiB.
+             */
+            maxMem?: number
+        }): SourceRanges;
+    }
+
+    /**
+     * A source made by {@link Source.newFromRanges}.
+     */
+    class SourceRanges extends Source {
+        /**
+         * Get the statistics of the block cache.
+         * @return The statistics.
+         */
+        stats(): RangeStats;
+    }
+
+    /**
+     * Statistics of the block cache of a {@link SourceRanges}.
+     */
+    interface RangeStats {
+        /**
+         * Number of cached blocks.
+         */
+        blocks: number;
+
+        /**
+         * Number of bytes held by the cached blocks.
+         */
+        mem: number;
+
+        /**
+         * Number of blocks that were read from the cache.
+         */
+        hits: number;
+
+        /**
+         * Number of blocks that had to be fetched.
+         */
+        misses: number;
+
+        /**
+         * Number of calls to the fetch function.
+         */
+        fetches: number;
+
+        /**
+         * Number of bytes returned by the fetch function.
+         */
+        bytesFetched: number;
+
+        /**
+         * The fraction of blocks that were read from the cache.
+         */
+        hitRatio: number;
     }
 
     /**
@@ -372,11 +840,57 @@ declare namespace Vips {
          * Attach a seek handler.
          * Seek handlers are optional. If you do not set one, your source will be
          * treated as unseekable and libvips will do extra caching.
+         * Offsets are exact up to 2^53 bytes, so sources larger than 2 GiB can
+         * be read at random, e.g. a BigTIFF served by range requests.
          * @param offset A byte offset relative to the whence parameter.
          * @param size A value indicating the reference point used to obtain the new position.
          * @return The new position within the current source.
          */
-        onSeek: (offset: number, whence: number) => number;
+        onSeek: (offset: number, whence: number) => number | bigint;
+
+        /**
+         * The read-ahead window in bytes, 0 (the default) disables read-ahead.
+         *
+         * With read-ahead, {@link onRead} is asked for `readAhead` bytes at a time.
+         * While a sequential decoder consumes the buffered bytes on a worker thread,
+         * the next window is requested on the main thread, so that I/O latency
+         * overlaps with decoding. For example:
+         * ```js
+         * source.readAhead = 1024 * 1024;
+         * ```
+         */
+        readAhead: number;
+
+        /**
+         * Get the read-ahead statistics, see {@link readAhead}.
+         * @return The statistics.
+         */
+        stats(): ReadAheadStats;
+    }
+
+    /**
+     * Read-ahead statistics of a {@link SourceCustom}.
+     */
+    interface ReadAheadStats {
+        /**
+         * Number of calls to the read handler.
+         */
+        fetches: number;
+
+        /**
+         * Number of bytes returned by the read handler.
+         */
+        bytesFetched: number;
+
+        /**
+         * Number of reads that had to wait for the read handler.
+         */
+        stalls: number;
+
+        /**
+         * Milliseconds spent waiting for the read handler.
+         */
+        stallTime: number;
     }
 
     /**
@@ -446,7 +960,7 @@ declare namespace Vips {
          * @param size A value indicating the reference point used to obtain the new position.
          * @return The new position within the current target.
          */
-        onSeek: (offset: number, whence: number) => number;
+        onSeek: (offset: number, whence: number) => number | bigint;
 
         /**
          * Attach an end handler.
@@ -470,6 +984,141 @@ declare namespace Vips {
         static newFromName(nickname: string): Interpolate;
     }
 
+    /**
+     * A fixed set of equally sized pixel buffers on the Wasm heap, for frame
+     * loops that would otherwise allocate new input and output buffers for
+     * every frame.
+     *
+     * ```js
+     * const pool = new vips.FramePool(width, height, 4, 'uchar', 4);
+     * const ptr = pool.acquire();
+     * await frame.copyTo(pool.view(ptr), { format: 'RGBA' });
+     * const out = pool.write(pool.image(ptr).gaussblur(2));
+     * ctx.putImageData(new ImageData(new Uint8ClampedArray(pool.view(out)), width, height), 0, 0);
+     * pool.release(out);
+     * ```
+     *
+     * A buffer wrapped with {@link image} goes back to the pool once the
+     * image is gone. The libvips operation cache keeps the inputs of cached
+     * operations alive, so when the pool runs out, {@link acquire} first
+     * drops the cached operations that use an image made from the pool.
+     */
+    class FramePool extends EmbindClassHandle<FramePool> {
+        /**
+         * Allocate `count` buffers for images of the given size and format.
+         * @param width Image width in pixels.
+         * @param height Image height in pixels.
+         * @param bands Number of bands.
+         * @param format Band format.
+         * @param count Number of buffers.
+         */
+        constructor(width: number, height: number, bands: number, format: BandFormat, count: number);
+
+        readonly width: number;
+        readonly height: number;
+        readonly bands: number;
+
+        /**
+         * Number of buffers.
+         */
+        readonly count: number;
+
+        /**
+         * Size of a buffer in bytes.
+         */
+        readonly size: number;
+
+        /**
+         * Number of buffers that are not in use.
+         */
+        readonly available: number;
+
+        /**
+         * Take a free buffer from the pool.
+         * @return The address of the buffer.
+         */
+        acquire(): number;
+
+        /**
+         * Give an acquired buffer back to the pool. Buffers wrapped with
+         * {@link image} can't be released, they are given back
+         * automatically once the image is gone.
+         * @param ptr The address of the buffer.
+         */
+        release(ptr: number): void;
+
+        /**
+         * A typed array view on a buffer, without copying.
+         * @param ptr The address of the buffer.
+         * @return A view on the buffer.
+         */
+        view(ptr: number): Memory;
+
+        /**
+         * Wrap an acquired buffer in an image, without copying. A buffer can
+         * only be wrapped once, it goes back to the pool when the image is
+         * gone.
+         * @param ptr The address of the buffer.
+         * @return A new image.
+         */
+        image(ptr: number): Image;
+
+        /**
+         * Render an image into a free buffer. The image must have the size
+         * and format of the pool.
+         * @param image The image to render.
+         * @return The address of the buffer, give it back with {@link release}.
+         */
+        write(image: Image): number;
+    }
+
+    /**
+     * Read rectangles of pixels from an image.
+     *
+     * Only the requested rectangle is computed through the pipeline, so
+     * this is much cheaper than {@link Image.writeToMemory} when you need
+     * a small part of a large image, for example a viewport.
+     */
+    class Region extends EmbindClassHandle<Region> {
+        /**
+         * Make a region on an image.
+         * @param image The image to read from.
+         * @return A new region.
+         */
+        static newFromImage(image: Image): Region;
+
+        /**
+         * Compute a rectangle and copy its pixels out.
+         *
+         * The rectangle is clipped to the image. Pixels are band
+         * interleaved, in a typed array matching the band format.
+         * @param left Left edge of the rectangle.
+         * @param top Top edge of the rectangle.
+         * @param width Width of the rectangle.
+         * @param height Height of the rectangle.
+         * @return The pixels of the rectangle.
+         */
+        fetch(left: number, top: number, width: number, height: number): Memory;
+
+        /**
+         * Compute a rectangle and copy its pixels out, shrunk by a power of
+         * two, for example to draw a zoomed out viewport.
+         *
+         * The rectangle must lie within the image, and its position and
+         * size must be a multiple of `factor`.
+         * @param left Left edge of the rectangle.
+         * @param top Top edge of the rectangle.
+         * @param width Width of the rectangle.
+         * @param height Height of the rectangle.
+         * @param factor Shrink factor, a power of two.
+         * @param method How to shrink each 2x2 block, defaults to
+         * {@link RegionShrink.mean}.
+         * @return The pixels of the shrunk rectangle.
+         */
+        shrink(left: number, top: number, width: number, height: number, factor: number,
+               method?: RegionShrink | Enum): Memory;
+    }
+
     /**
      * An image class.
      */
@@ -646,7 +1295,8 @@ declare namespace Vips {
          * const data = new Uint8Array([1, 2, 3, 4]);
          * const image = vips.Image.newFromMemory(data, 2, 2, 1, vips.BandFormat.uchar);
          * ```
-         * The data object will internally be copied from JavaScript to Wasm.
+         * The data object will internally be copied from JavaScript to Wasm,
+         * once.
          *
          * This method is useful for efficiently transferring images from WebGL into
          * libvips.
@@ -677,6 +1327,100 @@ declare namespace Vips {
          */
         static newFromMemory(ptr: number, size: number, width: number, height: number, bands: number, format: BandFormat): Image;
 
+        /**
+         * Wrap an image around memory allocated with `_malloc`, without
+         * copying it.
+         *
+         * Unlike {@link newFromMemory}, the image takes ownership of the
+         * memory and frees it once the image is no longer used. The memory
+         * is also freed if the image can't be made, so don't free it
+         * yourself.
+         * @param ptr A memory address, allocated with `_malloc`.
+         * @param size Length of memory area.
+         * @param width Image width in pixels.
+         * @param height Image height in pixels.
+         * @param bands Number of bands.
+         * @param format Band format.
+         * @return A new image.
+         */
+        static newFromMemoryOwned(ptr: number, size: number, width: number, height: number, bands: number,
+                                  format: BandFormat): Image;
+
+        /**
+         * Load a vips-format (`.v`) or raw file by reading all pixels into
+         * memory with a single read, without decoding.
+         *
+         * On Node.js, this is one large `fs.readSync()` straight into the
+         * Wasm heap, rather than the many small reads of {@link newFromFile}.
+         * The image owns the memory and frees it once it's no longer used.
+         * Metadata in the `.v` extension block is kept. Other file formats,
+         * files with the other byte order, or coded images, are loaded with
+         * {@link newFromFile}.
+         *
+         * Raw files have no header, pass their layout as options:
+         * ```js
+         * const image = vips.Image.newFromFileMapped('pixels.raw', {
+         *     width: 1024,
+         *     height: 768,
+         *     bands: 3,
+         *     format: 'uchar'
+         * });
+         * ```
+         * @param filename The file to load the image from.
+         * @param options Image layout, for raw files only.
+         * @return A new image.
+         */
+        static newFromFileMapped(filename: string, options?: {
+            /**
+             * Image width in pixels.
+             */
+            width: number
+            /**
+             * Image height in pixels.
+             */
+            height: number
+            /**
+             * Number of bands.
+             */
+            bands: number
+            /**
+             * Band format.
+             */
+            format: BandFormat
+            /**
+             * Offset in bytes from the start of the file, defaults to 0.
+             */
+            offset?: number
+        }): Image;
+
+        /**
+         * Make a four-band uchar image from an `ImageData`, for example from
+         * `CanvasRenderingContext2D.getImageData()`. The pixels are copied
+         * once.
+         * @param imageData The image data.
+         * @return A new image.
+         */
+        static newFromImageData(imageData: { data: Uint8ClampedArray, width: number, height: number }): Image;
+
+        /**
+         * Make a four-band uchar sRGB image from a `VideoFrame`, for example
+         * from a webcam stream. The frame is converted to RGBA and copied
+         * straight into memory that the image owns, so there is no further
+         * copy. Only available on the web.
+         * @param frame The video frame, you still need to close it.
+         * @return A promise for the new image.
+         */
+        static newFromVideoFrame(frame: VideoFrame): Promise<Image>;
+
+        /**
+         * Make a four-band uchar sRGB image from an `ImageBitmap`, for
+         * example from `createImageBitmap()`. As {@link newFromVideoFrame},
+         * the pixels are copied once. Only available on the web.
+         * @param bitmap The image bitmap, you still need to close it.
+         * @return A promise for the new image.
+         */
+        static newFromImageBitmap(bitmap: ImageBitmap): Promise<Image>;
+
         /**
          * Load a formatted image from memory.
          *
@@ -728,6 +1472,9 @@ declare namespace Vips {
          * A new one-band image with {@link BandFormat.double} pixels is
          * created from the array. These images are useful with the libvips
          * convolution operator {@link conv}.
+         *
+         * The values are copied in one go, a `Float64Array` is the fastest
+         * way to pass a large matrix, for example a lookup table.
          * @param width Image width.
          * @param height Image height.
          * @param array Create the image from these values.
@@ -739,7 +1486,8 @@ declare namespace Vips {
          * Create an image from a 2D array.
          *
          * A new one-band image with {@link BandFormat.double} pixels is
-         * created from the array. These images are useful with the libvips
+         * created from the array. A 1D array or a `Float64Array` makes a
+         * single row. These images are useful with the libvips
          * convolution operator {@link conv}.
          * @param array Create the image from these values.
          * @param scale Default to 1.0. What to divide each pixel by after
@@ -748,7 +1496,7 @@ declare namespace Vips {
          * after convolution. Useful for integer convolution masks.
          * @return A new image.
          */
-        static newFromArray(array: ArrayConstant, scale?: number, offset?: number): Image;
+        static newFromArray(array: ArrayConstant | number[][], scale?: number, offset?: number): Image;
 
         /**
          * Make a new image from an existing one.
@@ -873,6 +1621,57 @@ declare namespace Vips {
          */
         writeToMemory(): Memory;
 
+        /**
+         * Render the image to memory on the Wasm heap, for example a buffer
+         * allocated with `_malloc` that is reused between calls. The
+         * memory area must be at least as large as the image.
+         * @param ptr Address of the memory area.
+         * @param size Size of the memory area in bytes.
+         */
+        writeToMemory(ptr: number, size: number): void;
+
+        /**
+         * Iterate over the image a strip of scanlines at a time.
+         *
+         * The image is evaluated once, top to bottom, off the main thread.
+         * Each strip is gathered into the same buffer, so memory use stays at
+         * `height * width * bands` pixels, no matter the size of the image.
+         * The `data` of a strip is a view on that buffer, and is only valid
+         * until the next strip is requested. Copy it if you need to hold on
+         * to the pixels.
+         * ```js
+         * for await (const { top, height, data } of im.strips(128)) {
+         *   tensor.set(data, top * im.width * im.bands);
+         * }
+         * ```
+         * @param height Number of scanlines per strip, defaults to 128. The
+         * last strip can be shorter.
+         * @return An async iterator of strips.
+         */
+        strips(height?: number): AsyncGenerator<{ top: number, height: number, data: Memory }, void, void>;
+
+        /**
+         * Render the image as 8-bit sRGB with an alpha channel, ready to draw
+         * on a canvas.
+         *
+         * The image is converted to sRGB, cast to uchar, grey is replicated
+         * and an opaque alpha is added when needed, all in a single pass.
+         *
+         * When `dest` is a view on the Wasm heap, the pixels are rendered
+         * straight into it, otherwise they are copied once.
+         * @param dest Write the pixels to this array instead of a new one,
+         * it must hold at least `width * height * 4` bytes.
+         * @return `dest`, or a new `Uint8ClampedArray`.
+         */
+        toRGBA8(dest?: Uint8ClampedArray | Uint8Array): Uint8ClampedArray | Uint8Array;
+
+        /**
+         * Render the image as an `ImageData`, see {@link toRGBA8}. Only
+         * available on the web.
+         * @return A new `ImageData`.
+         */
+        toImageData(): ImageData;
+
         //#endregion
 
         //#region get/set metadata
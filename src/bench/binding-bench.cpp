@@ -0,0 +1,141 @@
+// Measure the overhead of the bindings on tiny images, where the pixel
+// work is negligible: the time and the number of C++ allocations per call
+// spent in Image::call(), Option and Image::imageize().
+//
+// Build with `-Dbenchmarks=true` and run with:
+//   node binding-bench.js
+
+#include "../bindings/image.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <emscripten/val.h>
+
+#include <vips/vips.h>
+
+using vips::Image;
+using vips::Option;
+
+static std::atomic<size_t> allocations(0);
+
+void *operator new(size_t size) {
+    allocations++;
+
+    void *ptr = malloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+template <typename F>
+static void bench(const char *name, F fn) {
+    using clock = std::chrono::steady_clock;
+
+    // warm up, this also fills any lazily initialized type tables
+    for (int i = 0; i < 100; ++i)
+        fn();
+
+    // double the iterations until we run for at least half a second
+    size_t iterations = 100;
+    double elapsed_ns;
+    size_t allocs;
+    for (;;) {
+        size_t allocs_start = allocations;
+        auto start = clock::now();
+
+        for (size_t i = 0; i < iterations; ++i)
+            fn();
+
+        elapsed_ns =
+            std::chrono::duration<double, std::nano>(clock::now() - start)
+                .count();
+        allocs = allocations - allocs_start;
+
+        if (elapsed_ns >= 5e8)
+            break;
+
+        iterations *= 2;
+    }
+
+    printf("%-36s %12.0f ns/call %10.2f allocs/call\n", name,
+           elapsed_ns / iterations, static_cast<double>(allocs) / iterations);
+}
+
+int main() {
+    if (vips_init("binding-bench"))
+        vips_error_exit("unable to start up libvips");
+
+    // we want to measure building operations, not cache lookups
+    vips_cache_set_max(0);
+
+    emscripten::val rgb = emscripten::val::object();
+    rgb.set("bands", 3);
+
+    Image tiny = Image::black(8, 8).copy_memory();
+    Image tiny_rgb = Image::black(8, 8, rgb).copy_memory();
+
+    printf("%-36s %12s %21s\n", "benchmark", "time", "allocations");
+
+    // Tiny-image op chains
+    bench("call: invert", [&]() {
+        Image out = tiny.invert();
+    });
+    bench("call: invert (Option, no kwargs)", [&]() {
+        Image out;
+        Image::call("invert", nullptr,
+                    (new Option)->set("in", tiny)->set("out", &out),
+                    emscripten::val::null());
+    });
+    bench("chain: invert.flip.avg", [&]() {
+        tiny.invert().flip(VIPS_DIRECTION_HORIZONTAL).avg();
+    });
+
+    // kwargs-heavy calls
+    emscripten::val embed_options = emscripten::val::object();
+    embed_options.set("extend", emscripten::val("background"));
+    emscripten::val background = emscripten::val::array();
+    background.call<void>("push", 1, 2, 3);
+    embed_options.set("background", background);
+    bench("kwargs: embed {extend, background}", [&]() {
+        Image out = tiny_rgb.embed(1, 1, 10, 10, embed_options);
+    });
+
+    emscripten::val affine_options = emscripten::val::object();
+    affine_options.set("odx", 0.5);
+    affine_options.set("ody", 0.5);
+    affine_options.set("idx", 0.5);
+    affine_options.set("idy", 0.5);
+    affine_options.set("extend", emscripten::val("copy"));
+    emscripten::val identity = emscripten::val::array();
+    identity.call<void>("push", 1, 0, 0, 1);
+    bench("kwargs: affine {5 options}", [&]() {
+        Image out = tiny.affine(identity, affine_options);
+    });
+
+    // Constant to image promotion
+    emscripten::val scalar(0.5);
+    emscripten::val pixel = emscripten::val::array();
+    pixel.call<void>("push", 255, 255, 255);
+    bench("imageize: 0.5", [&]() {
+        Image out = tiny.imageize(scalar);
+    });
+    bench("imageize: [255, 255, 255]", [&]() {
+        Image out = tiny_rgb.imageize(pixel);
+    });
+    bench("ifthenelse: constants", [&]() {
+        Image out = tiny.ifthenelse(pixel, scalar);
+    });
+
+    vips_shutdown();
+
+    return 0;
+}
@@ -0,0 +1,996 @@
+#include "cache.h"
+
+#include "image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <list>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <emscripten/heap.h>
+
+#include <glib/gstdio.h>
+
+namespace vips {
+
+/**
+ * The provenance keys of live images. Images can be finalized on any
+ * thread, so this needs a lock.
+ */
+static std::mutex provenance_lock;
+static std::unordered_map<VipsImage *, std::string> provenance;
+
+static void provenance_notify(gpointer data, GObject *where_the_object_was) {
+    std::lock_guard<std::mutex> lock(provenance_lock);
+    provenance.erase(reinterpret_cast<VipsImage *>(where_the_object_was));
+}
+
+static void set_provenance(VipsImage *image, const std::string &key) {
+    std::lock_guard<std::mutex> lock(provenance_lock);
+
+    auto it = provenance.find(image);
+    if (it == provenance.end()) {
+        g_object_weak_ref(G_OBJECT(image), provenance_notify, nullptr);
+        provenance.emplace(image, key);
+    } else {
+        it->second = key;
+    }
+}
+
+static std::string get_provenance(VipsImage *image) {
+    std::lock_guard<std::mutex> lock(provenance_lock);
+
+    auto it = provenance.find(image);
+    return it == provenance.end() ? std::string() : it->second;
+}
+
+static void remove_provenance(VipsImage *image) {
+    std::lock_guard<std::mutex> lock(provenance_lock);
+
+    if (provenance.erase(image) > 0)
+        g_object_weak_unref(G_OBJECT(image), provenance_notify, nullptr);
+}
+
+/**
+ * Hash a string, including the terminating NUL so that consecutive
+ * strings can't run into each other.
+ */
+static void hash_string(GChecksum *checksum, const char *str) {
+    g_checksum_update(checksum, reinterpret_cast<const guchar *>(str),
+                      strlen(str) + 1);
+}
+
+static void hash_data(GChecksum *checksum, const void *data, size_t length) {
+    hash_string(checksum, std::to_string(length).c_str());
+    g_checksum_update(checksum, static_cast<const guchar *>(data), length);
+}
+
+static bool hash_image(GChecksum *checksum, VipsImage *image) {
+    std::string key = get_provenance(image);
+    if (key.empty())
+        return false;
+
+    hash_string(checksum, key.c_str());
+    return true;
+}
+
+/**
+ * Hash a GValue, or return false if we can't hash this type.
+ */
+static bool hash_value(GChecksum *checksum, const GValue *value) {
+    GType type = G_VALUE_TYPE(value);
+
+    if (type == VIPS_TYPE_IMAGE) {
+        return hash_image(checksum, VIPS_IMAGE(g_value_get_object(value)));
+    } else if (type == VIPS_TYPE_ARRAY_IMAGE) {
+        int n;
+        VipsImage **images = vips_value_get_array_image(value, &n);
+
+        for (int i = 0; i < n; ++i)
+            if (!hash_image(checksum, images[i]))
+                return false;
+    } else if (type == VIPS_TYPE_BLOB) {
+        size_t length;
+        const void *data = vips_value_get_blob(value, &length);
+
+        hash_data(checksum, data, length);
+    } else if (type == VIPS_TYPE_ARRAY_DOUBLE) {
+        int n;
+        double *array = vips_value_get_array_double(value, &n);
+
+        hash_data(checksum, array, n * sizeof(double));
+    } else if (type == VIPS_TYPE_ARRAY_INT) {
+        int n;
+        int *array = vips_value_get_array_int(value, &n);
+
+        hash_data(checksum, array, n * sizeof(int));
+    } else if (type == VIPS_TYPE_REF_STRING) {
+        hash_string(checksum, vips_value_get_ref_string(value, nullptr));
+    } else if (g_type_is_a(type, VIPS_TYPE_INTERPOLATE)) {
+        VipsObject *object = VIPS_OBJECT(g_value_get_object(value));
+
+        hash_string(checksum, VIPS_OBJECT_GET_CLASS(object)->nickname);
+    } else if (G_TYPE_IS_OBJECT(type) || G_TYPE_IS_BOXED(type) ||
+               type == G_TYPE_POINTER) {
+        // sources, targets and friends
+        return false;
+    } else {
+        char *str = g_strdup_value_contents(value);
+        hash_string(checksum, str);
+        g_free(str);
+    }
+
+    return true;
+}
+
+/**
+ * Hash a set of JS options, or return false if one of them can't be
+ * hashed, eg. an image, a target or a callback.
+ */
+static bool hash_options(GChecksum *checksum, emscripten::val js_options) {
+    if (js_options.isNull() || js_options.isUndefined())
+        return true;
+
+    emscripten::val keys = ObjectKeysVal(js_options);
+
+    std::vector<std::string> names;
+    int key_length = keys["length"].as<int>();
+    for (int i = 0; i < key_length; ++i)
+        names.push_back(keys[i].as<std::string>());
+
+    // {Q: 80, strip: true} and {strip: true, Q: 80} are the same
+    std::sort(names.begin(), names.end());
+
+    emscripten::val to_string = emscripten::val::global("String");
+    for (const std::string &name : names) {
+        emscripten::val value = js_options[name];
+
+        bool scalar = !is_type(value, "object") && !is_type(value, "function");
+        if (!scalar && value.isArray()) {
+            scalar = true;
+            unsigned l = value["length"].as<unsigned>();
+            for (unsigned i = 0; i < l; ++i)
+                scalar = scalar && is_type(value[i], "number");
+        }
+
+        // images, targets, callbacks, ...
+        if (!scalar)
+            return false;
+
+        hash_string(checksum, name.c_str());
+        hash_string(checksum, to_string(value).as<std::string>().c_str());
+    }
+
+    return true;
+}
+
+/**
+ * Files can change, so for loaders we hash the file size and modification
+ * time as well.
+ */
+static bool hash_file(GChecksum *checksum, const GValue *value) {
+    const char *filename = g_value_get_string(value);
+
+    GStatBuf st;
+    if (filename == nullptr || g_stat(filename, &st))
+        return false;
+
+    std::string stamp =
+        std::to_string(st.st_size) + ":" + std::to_string(st.st_mtime);
+    hash_string(checksum, stamp.c_str());
+
+    return true;
+}
+
+static void *hash_input(VipsObject *object, GParamSpec *pspec,
+                        VipsArgumentClass *argument_class,
+                        VipsArgumentInstance *argument_instance, void *a,
+                        void *b) {
+    GChecksum *checksum = static_cast<GChecksum *>(a);
+    bool *cacheable = static_cast<bool *>(b);
+    const char *name = g_param_spec_get_name(pspec);
+    GType type = G_PARAM_SPEC_VALUE_TYPE(pspec);
+
+    if ((argument_class->flags & VIPS_ARGUMENT_OUTPUT) ||
+        !argument_instance->assigned)
+        return nullptr;
+
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, type);
+    g_object_get_property(G_OBJECT(object), name, &value);
+
+    // An image modified in-place is no longer what its key says it is.
+    if (argument_class->flags & VIPS_ARGUMENT_MODIFY) {
+        if (type == VIPS_TYPE_IMAGE)
+            remove_provenance(VIPS_IMAGE(g_value_get_object(&value)));
+
+        *cacheable = false;
+    } else {
+        hash_string(checksum, name);
+
+        if (g_type_is_a(G_OBJECT_TYPE(object), VIPS_TYPE_FOREIGN_LOAD) &&
+            strcmp(name, "filename") == 0)
+            *cacheable = hash_file(checksum, &value);
+
+        if (*cacheable)
+            *cacheable = hash_value(checksum, &value);
+    }
+
+    g_value_unset(&value);
+
+    return *cacheable ? nullptr : object;
+}
+
+static void *tag_output(VipsObject *object, GParamSpec *pspec,
+                        VipsArgumentClass *argument_class,
+                        VipsArgumentInstance *argument_instance, void *a,
+                        void *b) {
+    GChecksum *base = static_cast<GChecksum *>(a);
+    const char *name = g_param_spec_get_name(pspec);
+
+    if (!(argument_class->flags & VIPS_ARGUMENT_OUTPUT) ||
+        !argument_instance->assigned ||
+        G_PARAM_SPEC_VALUE_TYPE(pspec) != VIPS_TYPE_IMAGE)
+        return nullptr;
+
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, VIPS_TYPE_IMAGE);
+    g_object_get_property(G_OBJECT(object), name, &value);
+
+    VipsImage *image = VIPS_IMAGE(g_value_get_object(&value));
+    if (image != nullptr) {
+        GChecksum *checksum = g_checksum_copy(base);
+        hash_string(checksum, name);
+        set_provenance(image, g_checksum_get_string(checksum));
+        g_checksum_free(checksum);
+    }
+
+    g_value_unset(&value);
+
+    return nullptr;
+}
+
+static void *hash_field(VipsImage *image, const char *name, GValue *value,
+                        void *a) {
+    GChecksum *checksum = static_cast<GChecksum *>(a);
+
+    hash_string(checksum, name);
+    return hash_value(checksum, value) ? nullptr : image;
+}
+
+/**
+ * The encoded results, most recently used first.
+ */
+struct CachedResult {
+    std::string key;
+    VipsBlob *blob;
+};
+
+static std::list<CachedResult> results;
+static std::unordered_map<std::string, std::list<CachedResult>::iterator>
+    result_index;
+
+static size_t max_mem = 0;
+static size_t mem = 0;
+static int hits = 0;
+static int misses = 0;
+static int evictions = 0;
+
+static emscripten::val store = emscripten::val::null();
+
+static void trim(size_t limit) {
+    while (mem > limit && !results.empty()) {
+        CachedResult &entry = results.back();
+
+        mem -= VIPS_AREA(entry.blob)->length;
+        vips_area_unref(VIPS_AREA(entry.blob));
+        result_index.erase(entry.key);
+        results.pop_back();
+
+        evictions++;
+    }
+}
+
+static void remember(const std::string &key, VipsBlob *blob) {
+    size_t length = VIPS_AREA(blob)->length;
+
+    if (length > max_mem || result_index.find(key) != result_index.end())
+        return;
+
+    vips_area_ref(VIPS_AREA(blob));
+    results.push_front({key, blob});
+    result_index.emplace(key, results.begin());
+    mem += length;
+
+    trim(max_mem);
+}
+
+bool ResultCache::enabled() {
+    return max_mem > 0 || !store.isNull();
+}
+
+size_t ResultCache::get_max_mem() {
+    return max_mem;
+}
+
+void ResultCache::set_max_mem(size_t new_max_mem) {
+    max_mem = new_max_mem;
+    trim(max_mem);
+}
+
+void ResultCache::set_store(emscripten::val new_store) {
+    store = new_store.isUndefined() ? emscripten::val::null() : new_store;
+}
+
+ResultCacheStats ResultCache::stats() {
+    return {static_cast<int>(results.size()), mem, hits, misses, evictions};
+}
+
+void ResultCache::clear() {
+    trim(0);
+
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+void ResultCache::tag(VipsOperation *operation) {
+    if (!enabled() ||
+        (vips_operation_get_flags(operation) & VIPS_OPERATION_NOCACHE))
+        return;
+
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    hash_string(checksum, VIPS_OBJECT_GET_CLASS(operation)->nickname);
+
+    bool cacheable = true;
+    vips_argument_map(VIPS_OBJECT(operation), hash_input, checksum,
+                      &cacheable);
+
+    if (cacheable)
+        vips_argument_map(VIPS_OBJECT(operation), tag_output, checksum,
+                          nullptr);
+
+    g_checksum_free(checksum);
+}
+
+std::string ResultCache::key(const Image &image, const std::string &suffix,
+                             emscripten::val js_options) {
+    if (!enabled())
+        return "";
+
+    std::string provenance_key = get_provenance(image.get_image());
+    if (provenance_key.empty())
+        return "";
+
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    hash_string(checksum, provenance_key.c_str());
+    hash_string(checksum, suffix.c_str());
+
+    if (!hash_options(checksum, js_options)) {
+        g_checksum_free(checksum);
+        return "";
+    }
+
+    // the metadata could have been changed after the image was made
+    bool cacheable =
+        vips_image_map(image.get_image(), hash_field, checksum) == nullptr;
+
+    std::string result = cacheable ? g_checksum_get_string(checksum) : "";
+    g_checksum_free(checksum);
+
+    return result;
+}
+
+VipsBlob *ResultCache::lookup(const std::string &key) {
+    auto it = result_index.find(key);
+    if (it != result_index.end()) {
+        results.splice(results.begin(), results, it->second);
+        hits++;
+
+        VipsBlob *blob = it->second->blob;
+        vips_area_ref(VIPS_AREA(blob));
+        return blob;
+    }
+
+    if (!store.isNull()) {
+        emscripten::val data = store.call<emscripten::val>("get", key);
+
+        if (data.instanceof(BlobVal)) {
+            size_t length = data["length"].as<size_t>();
+            void *buf = g_malloc(length);
+            emscripten::val(emscripten::typed_memory_view(
+                                length, static_cast<uint8_t *>(buf)))
+                .call<void>("set", data);
+
+            VipsBlob *blob = vips_blob_new(
+                reinterpret_cast<VipsCallbackFn>(vips_area_free_cb), buf,
+                length);
+
+            remember(key, blob);
+
+            hits++;
+            return blob;
+        }
+    }
+
+    misses++;
+    return nullptr;
+}
+
+void ResultCache::insert(const std::string &key, VipsBlob *blob) {
+    remember(key, blob);
+
+    if (!store.isNull())
+        store.call<void>("set", key,
+                         BlobVal.new_(emscripten::typed_memory_view(
+                             VIPS_AREA(blob)->length,
+                             static_cast<uint8_t *>(VIPS_AREA(blob)->data))));
+}
+
+/**
+ * The decoded images on disc, most recently used first.
+ */
+struct DecodedImage {
+    std::string key;
+    double size;
+};
+
+static std::string decode_dir;
+static double decode_max_size = 1024.0 * 1024 * 1024;
+static std::list<DecodedImage> decoded;
+static std::unordered_map<std::string, std::list<DecodedImage>::iterator>
+    decoded_index;
+static double decode_size = 0;
+static int decode_hits = 0;
+static int decode_misses = 0;
+static int decode_evictions = 0;
+
+static std::string decoded_path(const std::string &key) {
+    return decode_dir + G_DIR_SEPARATOR_S + key + ".v";
+}
+
+static void forget_decoded(std::list<DecodedImage>::iterator it) {
+    decode_size -= it->size;
+    decoded_index.erase(it->key);
+    decoded.erase(it);
+}
+
+static void remember_decoded(const std::string &key, double size) {
+    auto it = decoded_index.find(key);
+    if (it != decoded_index.end())
+        forget_decoded(it->second);
+
+    decoded.push_front({key, size});
+    decoded_index.emplace(key, decoded.begin());
+    decode_size += size;
+}
+
+static void trim_decoded(double limit) {
+    while (decode_size > limit && !decoded.empty()) {
+        // Images that are still open keep working, the file is only
+        // removed once they are closed.
+        (void) g_unlink(decoded_path(decoded.back().key).c_str());
+        forget_decoded(std::prev(decoded.end()));
+
+        decode_evictions++;
+    }
+}
+
+/**
+ * Our own files are named after a SHA-256, anything else in the directory
+ * is left alone.
+ */
+static bool is_decoded_name(const char *name) {
+    return strlen(name) == 66 && strspn(name, "0123456789abcdef") == 64 &&
+           strcmp(name + 64, ".v") == 0;
+}
+
+/**
+ * A file that insert() is still writing, or that was left behind by a
+ * process that stopped halfway, see DecodeCache::insert().
+ */
+static bool is_partial_name(const char *name) {
+    if (strspn(name, "0123456789abcdef") != 64 || name[64] != '-')
+        return false;
+
+    size_t digits = strspn(name + 65, "0123456789");
+    return digits > 0 && strcmp(name + 65 + digits, ".partial.v") == 0;
+}
+
+// Partial files that haven't been written to for this many seconds are
+// left over, rather than being written by another process.
+static const time_t partial_max_age = 60 * 60;
+
+/**
+ * Rebuild the index from the files in the directory, so that the size cap
+ * covers the images cached by other processes too. The modification time
+ * is bumped on every hit, so that gives the order. Stale partial files are
+ * removed along the way. Returns false if the directory can't be read.
+ */
+static bool scan_decoded(const std::string &dir) {
+    GDir *handle = g_dir_open(dir.c_str(), 0, nullptr);
+    if (handle == nullptr)
+        return false;
+
+    time_t now = time(nullptr);
+    std::vector<std::pair<time_t, DecodedImage>> found;
+    while (const char *name = g_dir_read_name(handle)) {
+        bool partial = is_partial_name(name);
+        if (!partial && !is_decoded_name(name))
+            continue;
+
+        std::string path = dir + G_DIR_SEPARATOR_S + name;
+        GStatBuf st;
+        if (g_stat(path.c_str(), &st) != 0)
+            continue;
+
+        if (partial) {
+            if (now - st.st_mtime > partial_max_age)
+                (void) g_unlink(path.c_str());
+        } else {
+            found.push_back(
+                {st.st_mtime,
+                 {std::string(name, 64), static_cast<double>(st.st_size)}});
+        }
+    }
+    g_dir_close(handle);
+
+    decoded.clear();
+    decoded_index.clear();
+    decode_size = 0;
+
+    // oldest first, so the most recent ends up at the front
+    std::sort(found.begin(), found.end(),
+              [](const auto &a, const auto &b) { return a.first < b.first; });
+    for (const auto &entry : found)
+        remember_decoded(entry.second.key, entry.second.size);
+
+    return true;
+}
+
+static std::string decode_key(GChecksum *checksum, const char *operation_name,
+                              const char *option_string,
+                              emscripten::val js_options) {
+    hash_string(checksum, operation_name);
+    hash_string(checksum, option_string);
+
+    std::string key = hash_options(checksum, js_options)
+                          ? g_checksum_get_string(checksum)
+                          : "";
+    g_checksum_free(checksum);
+
+    return key;
+}
+
+static bool decode_cacheable(const char *operation_name) {
+    // vips-format files are reopened without decoding anyway
+    return DecodeCache::enabled() &&
+           !vips_isprefix("VipsForeignLoadVips", operation_name);
+}
+
+bool DecodeCache::enabled() {
+    return !decode_dir.empty() && decode_max_size > 0;
+}
+
+std::string DecodeCache::get_dir() {
+    return decode_dir;
+}
+
+void DecodeCache::set_dir(const std::string &dir) {
+    decoded.clear();
+    decoded_index.clear();
+    decode_size = 0;
+    decode_dir.clear();
+
+    if (dir.empty())
+        return;
+
+    if (g_mkdir_with_parents(dir.c_str(), 0777)) {
+        vips_error_system(errno, "decodeDir", "unable to create \"%s\"",
+                          dir.c_str());
+        throw Error("unable to use " + dir + " for the decode cache");
+    }
+
+    if (!scan_decoded(dir))
+        throw Error("unable to use " + dir + " for the decode cache");
+
+    decode_dir = dir;
+
+    trim_decoded(decode_max_size);
+}
+
+double DecodeCache::get_max_size() {
+    return decode_max_size;
+}
+
+void DecodeCache::set_max_size(double max_size) {
+    decode_max_size = max_size;
+
+    if (!decode_dir.empty())
+        (void) scan_decoded(decode_dir);
+    trim_decoded(decode_max_size);
+}
+
+DecodeCacheStats DecodeCache::stats() {
+    return {static_cast<int>(decoded.size()), decode_size, decode_hits,
+            decode_misses, decode_evictions};
+}
+
+void DecodeCache::clear() {
+    if (!decode_dir.empty())
+        (void) scan_decoded(decode_dir);
+    trim_decoded(0);
+
+    decode_hits = 0;
+    decode_misses = 0;
+    decode_evictions = 0;
+}
+
+std::string DecodeCache::key_file(const char *filename,
+                                  const char *operation_name,
+                                  const char *option_string,
+                                  emscripten::val js_options) {
+    if (!decode_cacheable(operation_name))
+        return "";
+
+    FILE *fp = g_fopen(filename, "rb");
+    if (fp == nullptr)
+        return "";
+
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+
+    std::vector<guchar> chunk(64 * 1024);
+    size_t length = 0;
+    size_t n;
+    while ((n = fread(chunk.data(), 1, chunk.size(), fp)) > 0) {
+        g_checksum_update(checksum, chunk.data(), n);
+        length += n;
+    }
+    fclose(fp);
+
+    hash_string(checksum, std::to_string(length).c_str());
+
+    return decode_key(checksum, operation_name, option_string, js_options);
+}
+
+std::string DecodeCache::key_buffer(const void *data, size_t length,
+                                    const char *operation_name,
+                                    const char *option_string,
+                                    emscripten::val js_options) {
+    if (!decode_cacheable(operation_name))
+        return "";
+
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, static_cast<const guchar *>(data), length);
+    hash_string(checksum, std::to_string(length).c_str());
+
+    return decode_key(checksum, operation_name, option_string, js_options);
+}
+
+VipsImage *DecodeCache::lookup(const std::string &key) {
+    std::string path = decoded_path(key);
+    auto it = decoded_index.find(key);
+
+    // Another process might have cached this image.
+    if (it != decoded_index.end() ||
+        g_file_test(path.c_str(), G_FILE_TEST_EXISTS)) {
+        VipsImage *image = vips_image_new_mode(path.c_str(), "r");
+
+        if (image != nullptr) {
+            if (it != decoded_index.end()) {
+                decoded.splice(decoded.begin(), decoded, it->second);
+            } else {
+                GStatBuf st;
+                remember_decoded(key, g_stat(path.c_str(), &st) == 0
+                                          ? static_cast<double>(st.st_size)
+                                          : 0);
+            }
+
+            // Keep the order for other processes and later runs.
+            (void) g_utime(path.c_str(), nullptr);
+
+            decode_hits++;
+            return image;
+        }
+
+        // deleted behind our back
+        vips_error_clear();
+        if (it != decoded_index.end())
+            forget_decoded(it->second);
+    }
+
+    decode_misses++;
+    return nullptr;
+}
+
+VipsImage *DecodeCache::insert(const std::string &key, VipsImage *image) {
+    double size = VIPS_IMAGE_SIZEOF_IMAGE(image);
+    if (size > decode_max_size)
+        return nullptr;
+
+    // Write to a partial file and rename it into place, so readers only
+    // ever see complete files. This is what vips_image_new_temp_file()
+    // does, but we keep the file when the image is closed.
+    std::string path = decoded_path(key);
+    std::string partial = decode_dir + G_DIR_SEPARATOR_S + key + "-" +
+                          std::to_string(g_random_int()) + ".partial.v";
+
+    VipsImage *disc = vips_image_new_mode(partial.c_str(), "w");
+    if (disc == nullptr || vips_image_write(image, disc)) {
+        VIPS_UNREF(disc);
+        (void) g_unlink(partial.c_str());
+        vips_error_clear();
+        return nullptr;
+    }
+    g_object_unref(disc);
+
+    if (g_rename(partial.c_str(), path.c_str())) {
+        (void) g_unlink(partial.c_str());
+        return nullptr;
+    }
+
+    VipsImage *cached = vips_image_new_mode(path.c_str(), "r");
+    if (cached == nullptr) {
+        vips_error_clear();
+        return nullptr;
+    }
+
+    GStatBuf st;
+    if (g_stat(path.c_str(), &st) == 0)
+        size = st.st_size;
+
+    // Pick up what other processes have cached since, our image goes in
+    // front whatever its modification time says.
+    (void) scan_decoded(decode_dir);
+    remember_decoded(key, size);
+    trim_decoded(decode_max_size);
+
+    return cached;
+}
+
+/**
+ * The cacheable operations we've built. Operations can be finalized on
+ * any thread, so this needs a lock.
+ */
+struct TrackedOperation {
+    const char *nickname;
+
+    // when we first saw the operation, in microseconds
+    gint64 added;
+
+    // number of times this operation was reused
+    int hits;
+};
+
+static std::mutex operations_lock;
+static std::unordered_map<VipsOperation *, TrackedOperation> operations;
+
+static int operation_hits = 0;
+static int operation_misses = 0;
+static int operation_evictions = 0;
+
+static void operation_notify(gpointer data, GObject *where_the_object_was) {
+    std::lock_guard<std::mutex> lock(operations_lock);
+
+    if (operations.erase(reinterpret_cast<VipsOperation *>(
+            where_the_object_was)) > 0)
+        operation_evictions++;
+}
+
+void OperationCache::track(const VipsOperation *original,
+                           VipsOperation *built) {
+    if (vips_operation_get_flags(built) & VIPS_OPERATION_NOCACHE)
+        return;
+
+    // vips_cache_operation_buildp() swaps in the cached operation on a hit
+    bool hit = original != built;
+
+    // On a miss, libvips doesn't always keep the operation, eg. with a
+    // cache size of 0. Those must not show up as evictions once they are
+    // finalized, so only track what's actually in the cache.
+    bool cached = hit;
+    if (!hit) {
+        VipsOperation *lookup = vips_cache_operation_lookup(built);
+        cached = lookup == built;
+        VIPS_UNREF(lookup);
+    }
+
+    std::lock_guard<std::mutex> lock(operations_lock);
+
+    if (hit)
+        operation_hits++;
+    else
+        operation_misses++;
+
+    if (!cached)
+        return;
+
+    auto it = operations.find(built);
+    if (it == operations.end()) {
+        g_object_weak_ref(G_OBJECT(built), operation_notify, nullptr);
+        it = operations
+                 .emplace(built,
+                          TrackedOperation{
+                              VIPS_OBJECT_GET_CLASS(built)->nickname,
+                              g_get_monotonic_time(), 0})
+                 .first;
+    }
+
+    if (hit)
+        it->second.hits++;
+}
+
+emscripten::val OperationCache::stats() {
+    std::map<std::string, int> counts;
+    gint64 now = g_get_monotonic_time();
+    gint64 oldest = now;
+    int hits, misses, evictions;
+
+    {
+        std::lock_guard<std::mutex> lock(operations_lock);
+
+        for (const auto &operation : operations) {
+            counts[operation.second.nickname]++;
+            oldest = std::min(oldest, operation.second.added);
+        }
+
+        hits = operation_hits;
+        misses = operation_misses;
+        evictions = operation_evictions;
+    }
+
+    emscripten::val by_nickname = emscripten::val::object();
+    for (const auto &count : counts)
+        by_nickname.set(count.first, count.second);
+
+    emscripten::val result = emscripten::val::object();
+    result.set("mem", vips_tracked_get_mem());
+    result.set("size", vips_cache_get_size());
+    result.set("operations", by_nickname);
+    result.set("hits", hits);
+    result.set("misses", misses);
+    result.set("evictions", evictions);
+    result.set("oldestAge",
+               (now - oldest) / static_cast<double>(G_USEC_PER_SEC));
+
+    return result;
+}
+
+int OperationCache::drop(emscripten::val filter) {
+    bool by_nickname = is_type(filter, "string");
+    bool by_predicate = is_type(filter, "function");
+    std::string nickname = by_nickname ? filter.as<std::string>() : "";
+
+    if (!by_nickname && !by_predicate && !filter.isUndefined())
+        throw std::invalid_argument(
+            "filter must be a nickname, a function or undefined");
+
+    // We can't invalidate while holding the lock, the operation might be
+    // finalized and call operation_notify().
+    std::vector<std::pair<VipsOperation *, TrackedOperation>> candidates;
+    {
+        std::lock_guard<std::mutex> lock(operations_lock);
+
+        for (const auto &operation : operations) {
+            if (by_nickname && nickname != operation.second.nickname)
+                continue;
+
+            g_object_ref(operation.first);
+            candidates.emplace_back(operation);
+        }
+    }
+
+    gint64 now = g_get_monotonic_time();
+    int dropped = 0;
+
+    for (const auto &candidate : candidates) {
+        bool match = true;
+
+        if (by_predicate) {
+            emscripten::val entry = emscripten::val::object();
+            entry.set("nickname", std::string(candidate.second.nickname));
+            entry.set("age", (now - candidate.second.added) /
+                                 static_cast<double>(G_USEC_PER_SEC));
+            entry.set("hits", candidate.second.hits);
+
+            match = filter(entry).as<bool>();
+        }
+
+        if (match) {
+            // this removes the operation from the libvips cache
+            vips_operation_invalidate(candidate.first);
+            dropped++;
+        }
+
+        g_object_unref(candidate.first);
+    }
+
+    return dropped;
+}
+
+int OperationCache::trim_tracked_mem(size_t bytes) {
+    int size = vips_cache_get_size();
+
+    // Setting max mem trims the cache, restore it afterwards.
+    size_t max_mem = vips_cache_get_max_mem();
+    vips_cache_set_max_mem(bytes);
+    vips_cache_set_max_mem(max_mem);
+
+    return size - vips_cache_get_size();
+}
+
+static std::atomic<bool> adaptive(true);
+static size_t memory_ceiling = 0;
+
+void AdaptiveCache::init() {
+    memory_ceiling = emscripten_get_heap_max();
+
+    emscripten::val ceiling =
+        emscripten::val::module_property("memoryCeiling");
+    if (is_type(ceiling, "number"))
+        memory_ceiling = std::min(memory_ceiling, ceiling.as<size_t>());
+
+    update();
+}
+
+bool AdaptiveCache::enabled() {
+    return adaptive;
+}
+
+void AdaptiveCache::set_enabled(bool enabled) {
+    adaptive = enabled;
+    update();
+}
+
+size_t AdaptiveCache::ceiling() {
+    return memory_ceiling;
+}
+
+// The tracked memory, which follows a rise at once and decays towards the
+// current value with a half-life of 5 seconds, so the cache grows back
+// gradually after a spike.
+static double smoothed_mem = 0;
+static gint64 smoothed_time = 0;
+
+static double smooth_mem() {
+    gint64 now = g_get_monotonic_time();
+    double mem = static_cast<double>(vips_tracked_get_mem());
+    double decay =
+        std::exp2(-(now - smoothed_time) / (5.0 * G_USEC_PER_SEC));
+
+    smoothed_mem = std::max(mem, smoothed_mem * decay + mem * (1.0 - decay));
+    smoothed_time = now;
+
+    return smoothed_mem;
+}
+
+void AdaptiveCache::update() {
+    if (!adaptive || memory_ceiling == 0)
+        return;
+
+    size_t heap = std::min(emscripten_get_heap_size(), memory_ceiling);
+    double budget = heap / 5.0;
+
+    double pressure = smooth_mem() / memory_ceiling;
+    double factor = std::clamp((1.0 - pressure) / 0.25, 0.0, 1.0);
+
+    size_t max_mem = static_cast<size_t>(budget * factor);
+
+    // 100 is the libvips default
+    int max_ops = static_cast<int>(std::ceil(100 * factor));
+
+    if (vips_cache_get_max_mem() != max_mem)
+        vips_cache_set_max_mem(max_mem);
+    if (vips_cache_get_max() != max_ops)
+        vips_cache_set_max(max_ops);
+}
+
+}  // namespace vips
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <string>
+
+#include <emscripten/val.h>
+
+#include <vips/vips.h>
+
+namespace vips {
+
+class Image;
+
+struct ResultCacheStats {
+    // number of cached results
+    int entries;
+
+    // bytes held by the cached results
+    size_t mem;
+
+    // lookups that were answered from the cache or the backing store
+    int hits;
+
+    // lookups that had to encode the image
+    int misses;
+
+    // results dropped to stay within the byte budget
+    int evictions;
+};
+
+/**
+ * An opt-in cache of encoded results.
+ *
+ * While enabled, every image made by an operation is tagged with a
+ * provenance key: a hash of the operation, its arguments and the keys of
+ * its input images, down to the content of the loaded buffer. Writing an
+ * image to a buffer then looks up the provenance key, the metadata, the
+ * suffix and the save options before encoding.
+ *
+ * Results are held in an LRU with a byte budget. Optionally, a JS backing
+ * store with `get(key)` and `set(key, data)` methods is consulted on a
+ * miss, so results can be shared between instances.
+ *
+ * This must only be used from the main runtime thread.
+ */
+class ResultCache {
+ public:
+    static bool enabled();
+
+    static size_t get_max_mem();
+
+    static void set_max_mem(size_t max_mem);
+
+    static void set_store(emscripten::val store);
+
+    static ResultCacheStats stats();
+
+    static void clear();
+
+    /**
+     * Tag the output images of a built operation with their provenance.
+     */
+    static void tag(VipsOperation *operation);
+
+    /**
+     * The key for writing an image with a set of save options, or an
+     * empty string if the result can't be cached.
+     */
+    static std::string key(const Image &image, const std::string &suffix,
+                           emscripten::val js_options);
+
+    /**
+     * Look up a key, our caller gets a reference to the result, or
+     * nullptr on a miss.
+     */
+    static VipsBlob *lookup(const std::string &key);
+
+    static void insert(const std::string &key, VipsBlob *blob);
+};
+
+struct DecodeCacheStats {
+    // number of cached images on disc
+    int entries;
+
+    // bytes held by the cached images
+    double size;
+
+    // loads that reopened a cached image
+    int hits;
+
+    // loads that had to decode the image
+    int misses;
+
+    // cached images deleted to stay within the size cap
+    int evictions;
+};
+
+/**
+ * An opt-in, disc-backed cache of decoded images.
+ *
+ * While a directory is set, loading an image from a file or a buffer
+ * hashes the content of the file or buffer, the loader and its options.
+ * On a miss, the decoded image is written to `<hash>.v` in the directory
+ * and reopened from there, on a hit the `.v` file is reopened without
+ * decoding anything. Since the directory outlives the process, so does the
+ * cache, and processes can share it.
+ *
+ * Files are evicted least-recently used first, by modification time, to
+ * stay within a size cap. The directory is scanned again before evicting,
+ * so the cap holds for the directory as a whole rather than per process.
+ * Partial files left over by a process that stopped halfway through a
+ * write are removed by the scan.
+ *
+ * This must only be used from the main runtime thread.
+ */
+class DecodeCache {
+ public:
+    static bool enabled();
+
+    static std::string get_dir();
+
+    /**
+     * Set the directory, or disable the cache with an empty string. The
+     * directory is created if needed, and any `.v` files in it are
+     * picked up.
+     */
+    static void set_dir(const std::string &dir);
+
+    static double get_max_size();
+
+    static void set_max_size(double max_size);
+
+    static DecodeCacheStats stats();
+
+    /**
+     * Delete all cached images and reset the statistics.
+     */
+    static void clear();
+
+    /**
+     * The key for loading a file or a buffer with a loader and a set of
+     * load options, or an empty string if the result can't be cached.
+     */
+    static std::string key_file(const char *filename,
+                                const char *operation_name,
+                                const char *option_string,
+                                emscripten::val js_options);
+
+    static std::string key_buffer(const void *data, size_t length,
+                                  const char *operation_name,
+                                  const char *option_string,
+                                  emscripten::val js_options);
+
+    /**
+     * Reopen a cached image, or get nullptr on a miss.
+     */
+    static VipsImage *lookup(const std::string &key);
+
+    /**
+     * Write a decoded image to the cache and reopen it, or get nullptr if
+     * it can't be written. Our caller should use the reopened image, using
+     * `image` itself would decode it again.
+     */
+    static VipsImage *insert(const std::string &key, VipsImage *image);
+};
+
+/**
+ * A shadow index of the libvips operation cache.
+ *
+ * libvips doesn't let us walk its operation cache, so we keep track of
+ * the cacheable operations built by Image::call() ourselves. An entry is
+ * removed when libvips drops the operation from its cache and the
+ * operation is finalized.
+ */
+class OperationCache {
+ public:
+    /**
+     * Track a built operation, if libvips keeps it in its cache.
+     * `original` is the operation before it was built, it's only used for
+     * comparison.
+     */
+    static void track(const VipsOperation *original, VipsOperation *built);
+
+    /**
+     * Get a JS object with the memory held, the number of operations per
+     * nickname, the hit, miss and eviction counts and the age in seconds
+     * of the oldest entry.
+     */
+    static emscripten::val stats();
+
+    /**
+     * Drop the operations matching a nickname, or for which a JS
+     * predicate returns true. Returns the number of dropped operations.
+     */
+    static int drop(emscripten::val filter);
+
+    /**
+     * Drop least-recently used operations until the tracked memory is
+     * below `bytes`, or the cache is empty. Like vips_cache_set_max_mem(),
+     * this compares against all memory tracked by libvips, not just the
+     * memory held by cached operations, which libvips doesn't report.
+     * Returns the number of dropped operations.
+     */
+    static int trim_tracked_mem(size_t bytes);
+};
+
+/**
+ * Size the libvips operation cache against the Wasm memory.
+ *
+ * The budget is a fifth of the current heap size, which grows with the
+ * heap (for the initial 256 MiB heap this is the 50 MiB we used to set).
+ * Once the tracked memory passes 75% of the ceiling, the budget and the
+ * number of cached operations shrink linearly, down to nothing at the
+ * ceiling. The tracked memory is smoothed, so the cache grows back
+ * gradually once the memory is released.
+ *
+ * The ceiling defaults to the maximum heap size and can be lowered with
+ * the `memoryCeiling` Module option.
+ */
+class AdaptiveCache {
+ public:
+    static void init();
+
+    static bool enabled();
+
+    static void set_enabled(bool enabled);
+
+    static size_t ceiling();
+
+    /**
+     * Re-evaluate the cache limits, this is cheap when nothing changed.
+     */
+    static void update();
+};
+
+}  // namespace vips
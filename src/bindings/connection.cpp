@@ -1,6 +1,22 @@
 #include "connection.h"
 #include "error.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <emscripten/proxying.h>
+#include <emscripten/threading.h>
+
 namespace vips {
 
 Source Source::new_from_file(const std::string &filename) {
@@ -24,6 +40,159 @@ Source Source::new_from_memory(const std::string &memory) {
     return Source(input);
 }
 
+// The read-ahead buffer of a SourceCustom. Chunks are requested from the
+// read handler on the main thread, in order, and appended to the buffer.
+struct SourceCustom::ReadAhead {
+    ReadCallback read_callback = nullptr;
+    size_t window = 0;
+
+    std::mutex lock;
+    std::condition_variable cond;
+
+    // buffered bytes start at head
+    std::vector<uint8_t> buffer;
+    size_t head = 0;
+
+    // chunks requested but not yet appended
+    int pending = 0;
+    bool eof = false;
+
+    // the read handler threw, reads fail until the next seek
+    bool failed = false;
+
+    int fetches = 0;
+    int64_t bytes_fetched = 0;
+    int stalls = 0;
+    double stall_time = 0;
+
+    size_t buffered() const {
+        return buffer.size() - head;
+    }
+
+    // must run on the main thread, without the lock held
+    void fetch() {
+        std::string chunk;
+        try {
+            emscripten::val val = emscripten::val::take_ownership(
+                read_callback(static_cast<double>(window)));
+            if (!val.isUndefined())
+                chunk = val.as<std::string>();
+        } catch (...) {
+            // the waiting reader must not hang on this chunk
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                failed = true;
+                pending--;
+            }
+            cond.notify_all();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if (head > 0 && head >= buffer.size() / 2) {
+                buffer.erase(buffer.begin(), buffer.begin() + head);
+                head = 0;
+            }
+            buffer.insert(buffer.end(), chunk.begin(), chunk.end());
+
+            if (chunk.empty())
+                eof = true;
+            pending--;
+            fetches++;
+            bytes_fetched += chunk.size();
+        }
+
+        cond.notify_all();
+    }
+
+    // request the next chunk, with the lock held
+    void request(const std::shared_ptr<ReadAhead> &self) {
+        pending++;
+        if (!proxy_async([self]() { self->fetch(); }))
+            pending--;
+    }
+
+    // wait for the chunks in flight, with the lock held
+    void drain(std::unique_lock<std::mutex> &guard) {
+        while (pending > 0) {
+            if (emscripten_is_main_runtime_thread()) {
+                // they are queued on our own thread
+                guard.unlock();
+                emscripten_proxy_execute_queue(
+                    emscripten_proxy_get_system_queue());
+                guard.lock();
+            } else {
+                cond.wait(guard);
+            }
+        }
+    }
+
+    int64_t read(const std::shared_ptr<ReadAhead> &self, void *data,
+                 int64_t length) {
+        std::unique_lock<std::mutex> guard(lock);
+
+        if (buffered() == 0 && !eof && !failed) {
+            auto start = std::chrono::steady_clock::now();
+
+            if (emscripten_is_main_runtime_thread()) {
+                // we can't wait for ourselves, fetch in place
+                drain(guard);
+                if (buffered() == 0 && !eof && !failed) {
+                    pending++;
+                    guard.unlock();
+                    fetch();
+                    guard.lock();
+                }
+            } else {
+                if (pending == 0)
+                    request(self);
+                cond.wait(guard, [&]() {
+                    return buffered() > 0 || eof || failed || pending == 0;
+                });
+            }
+
+            // the request couldn't be queued, or the read handler threw
+            if (buffered() == 0 && !eof)
+                return -1;
+
+            stalls++;
+            stall_time += std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+        }
+
+        if (buffered() == 0 && failed)
+            return -1;
+
+        size_t n = std::min(buffered(), static_cast<size_t>(length));
+        memcpy(data, buffer.data() + head, n);
+        head += n;
+
+        // keep the next window on its way while the decoder works
+        if (!eof && !failed && pending == 0 && buffered() < window)
+            request(self);
+
+        return n;
+    }
+
+    // drop the buffered bytes before seeking, returns how far the read
+    // handler is ahead of the decoder
+    int64_t discard() {
+        std::unique_lock<std::mutex> guard(lock);
+        drain(guard);
+
+        int64_t ahead = buffered();
+        buffer.clear();
+        head = 0;
+        eof = false;
+        failed = false;
+
+        return ahead;
+    }
+};
+
 int64_t SourceCustom::read_handler(VipsSourceCustom *source, void *data,
                                    int64_t length, void *user) {
     if (length <= 0)
@@ -33,10 +202,15 @@ int64_t SourceCustom::read_handler(VipsSourceCustom *source, void *data,
     if (self->read_callback == nullptr)
         return -1;
 
+    // set_read_ahead() can swap it on the main thread meanwhile
+    std::shared_ptr<ReadAhead> read_ahead = std::atomic_load(&self->read_ahead);
+    if (read_ahead != nullptr)
+        return read_ahead->read(read_ahead, data, length);
+
     int64_t bytes_read = 0;
     proxy_sync([&]() {
         emscripten::val val = emscripten::val::take_ownership(
-            self->read_callback(static_cast<int>(length)));
+            self->read_callback(static_cast<double>(length)));
         if (val.isUndefined())
             return;
 
@@ -50,30 +224,304 @@ int64_t SourceCustom::read_handler(VipsSourceCustom *source, void *data,
     return bytes_read;
 }
 
+// The position returned by a JS seek callback, or -1 if it's not a finite
+// number within the int64 range.
+static int64_t to_position(double pos) {
+    // -2^63 and 2^63 are exact as doubles, the latter is out of range
+    constexpr double min = static_cast<double>(INT64_MIN);
+
+    if (!std::isfinite(pos) || pos < min || pos >= -min)
+        return -1;
+
+    return static_cast<int64_t>(pos);
+}
+
 int64_t SourceCustom::seek_handler(VipsSourceCustom *source, int64_t offset,
                                    int whence, void *user) {
     SourceCustom *self = static_cast<SourceCustom *>(user);
     if (self->seek_callback == nullptr)
         return -1;
 
+    // the read handler is ahead of libvips by the bytes we buffered
+    std::shared_ptr<ReadAhead> read_ahead = std::atomic_load(&self->read_ahead);
+    if (read_ahead != nullptr) {
+        int64_t ahead = read_ahead->discard();
+        if (whence == SEEK_CUR)
+            offset -= ahead;
+    }
+
     int64_t new_pos;
     proxy_sync([&]() {
-        new_pos = self->seek_callback(static_cast<int>(offset), whence);
+        double pos = self->seek_callback(static_cast<double>(offset), whence);
+        new_pos = to_position(pos);
     });
 
     return new_pos;
 }
 
 void SourceCustom::set_read_callback(emscripten::val js_func) {
-    emscripten::val ptr = emscripten::val::module_property("addFunction")(
-        js_func, emscripten::val("ii"));
-    read_callback = reinterpret_cast<ReadCallback>(ptr.as<int>());
+    read_callback = add_function<ReadCallback>(js_func, "pd");
+
+    if (read_ahead != nullptr) {
+        std::lock_guard<std::mutex> guard(read_ahead->lock);
+        read_ahead->read_callback = read_callback;
+    }
 }
 
 void SourceCustom::set_seek_callback(emscripten::val js_func) {
-    emscripten::val ptr = emscripten::val::module_property("addFunction")(
-        js_func, emscripten::val("iii"));
-    seek_callback = reinterpret_cast<SeekCallback>(ptr.as<int>());
+    seek_callback = add_function<SeekCallback>(js_func, "ddi");
+}
+
+size_t SourceCustom::get_read_ahead() const {
+    return read_ahead == nullptr ? 0 : read_ahead->window;
+}
+
+void SourceCustom::set_read_ahead(size_t window) {
+    if (read_ahead == nullptr) {
+        if (window == 0)
+            return;
+
+        auto created = std::make_shared<ReadAhead>();
+        created->read_callback = read_callback;
+        std::atomic_store(&read_ahead, created);
+    }
+
+    std::unique_lock<std::mutex> guard(read_ahead->lock);
+    if (window > 0) {
+        read_ahead->window = window;
+        return;
+    }
+
+    // the buffered bytes would be lost
+    read_ahead->drain(guard);
+    if (read_ahead->buffered() > 0)
+        throw std::invalid_argument(
+            "can't disable read-ahead with bytes buffered");
+
+    guard.unlock();
+    std::atomic_store(&read_ahead, std::shared_ptr<ReadAhead>());
+}
+
+ReadAheadStats SourceCustom::stats() const {
+    if (read_ahead == nullptr)
+        return {0, 0, 0, 0};
+
+    std::lock_guard<std::mutex> guard(read_ahead->lock);
+    return {read_ahead->fetches,
+            static_cast<double>(read_ahead->bytes_fetched),
+            read_ahead->stalls, read_ahead->stall_time};
+}
+
+namespace {
+
+const char *const RANGES_KEY = "wasm-vips-ranges";
+
+// The blocks of a SourceRanges, most recently used first. The counters are
+// atomic, so that stats() doesn't wait for a read that is fetching.
+struct RangeCache {
+    FetchCallback fetch;
+    int64_t size;
+    int64_t block_size;
+    size_t max_blocks;
+
+    std::mutex lock;
+    int64_t position = 0;
+
+    using Block = std::pair<int64_t, std::vector<uint8_t>>;
+    std::list<Block> blocks;
+    std::unordered_map<int64_t, std::list<Block>::iterator> index;
+
+    std::atomic<int> n_blocks{0};
+    std::atomic<int64_t> mem{0};
+    std::atomic<int> hits{0};
+    std::atomic<int> misses{0};
+    std::atomic<int> fetches{0};
+    std::atomic<int64_t> bytes_fetched{0};
+
+    // fetch blocks [first, last] with a single call
+    bool fetch_run(int64_t first, int64_t last) {
+        int64_t offset = first * block_size;
+        int64_t length = std::min((last + 1) * block_size, size) - offset;
+
+        bool result = false;
+        proxy_sync([&]() {
+            emscripten::val data = emscripten::val::take_ownership(
+                fetch(static_cast<double>(offset),
+                      static_cast<double>(length)));
+            if (data.isUndefined() || data.isNull() ||
+                data["length"].as<double>() != static_cast<double>(length))
+                return;
+
+            for (int64_t block = first; block <= last; ++block) {
+                int64_t start = block * block_size - offset;
+                std::vector<uint8_t> bytes(
+                    std::min(block_size, size - block * block_size));
+
+                emscripten::val(
+                    emscripten::typed_memory_view(bytes.size(), bytes.data()))
+                    .call<void>("set",
+                                data.call<emscripten::val>(
+                                    "subarray", static_cast<double>(start),
+                                    static_cast<double>(start + bytes.size())));
+
+                mem += bytes.size();
+                n_blocks++;
+                blocks.emplace_front(block, std::move(bytes));
+                index[block] = blocks.begin();
+            }
+
+            fetches++;
+            bytes_fetched += length;
+            result = true;
+        });
+
+        return result;
+    }
+
+    // drop least-recently used blocks until we are within budget
+    void trim() {
+        while (blocks.size() > max_blocks) {
+            mem -= blocks.back().second.size();
+            n_blocks--;
+            index.erase(blocks.back().first);
+            blocks.pop_back();
+        }
+    }
+};
+
+int64_t ranges_read_handler(VipsSourceCustom *source, void *data,
+                            int64_t length, void *user) {
+    RangeCache *cache = static_cast<RangeCache *>(user);
+    std::lock_guard<std::mutex> lock(cache->lock);
+
+    if (length <= 0 || cache->position >= cache->size)
+        return 0;
+
+    int64_t end = std::min(cache->position + length, cache->size);
+    int64_t first = cache->position / cache->block_size;
+    int64_t last = (end - 1) / cache->block_size;
+
+    // fetch the missing blocks, a run of adjacent ones with a single call
+    int64_t run = -1;
+    for (int64_t block = first; block <= last; ++block) {
+        if (cache->index.count(block) != 0) {
+            cache->hits++;
+            if (run != -1 && !cache->fetch_run(run, block - 1))
+                return -1;
+            run = -1;
+        } else {
+            cache->misses++;
+            if (run == -1)
+                run = block;
+        }
+    }
+    if (run != -1 && !cache->fetch_run(run, last))
+        return -1;
+
+    uint8_t *out = static_cast<uint8_t *>(data);
+    for (int64_t block = first; block <= last; ++block) {
+        auto it = cache->index[block];
+        cache->blocks.splice(cache->blocks.begin(), cache->blocks, it);
+
+        int64_t start = cache->position - block * cache->block_size;
+        int64_t n = std::min(end, (block + 1) * cache->block_size) -
+                    cache->position;
+        memcpy(out, it->second.data() + start, n);
+
+        out += n;
+        cache->position += n;
+    }
+
+    // only now, a large read may need more blocks than the budget
+    cache->trim();
+
+    return out - static_cast<uint8_t *>(data);
+}
+
+int64_t ranges_seek_handler(VipsSourceCustom *source, int64_t offset,
+                            int whence, void *user) {
+    RangeCache *cache = static_cast<RangeCache *>(user);
+    std::lock_guard<std::mutex> lock(cache->lock);
+
+    int64_t new_pos;
+    switch (whence) {
+        case SEEK_SET:
+            new_pos = offset;
+            break;
+        case SEEK_CUR:
+            new_pos = cache->position + offset;
+            break;
+        case SEEK_END:
+            new_pos = cache->size + offset;
+            break;
+        default:
+            return -1;
+    }
+
+    if (new_pos < 0)
+        return -1;
+
+    cache->position = new_pos;
+
+    return new_pos;
+}
+
+}  // namespace
+
+SourceRanges SourceRanges::new_from_ranges(emscripten::val fetch_range,
+                                           double size,
+                                           emscripten::val js_options) {
+    double block_size = 256 * 1024;
+    double max_mem = 64 * 1024 * 1024;
+    if (!js_options.isUndefined() && !js_options.isNull()) {
+        if (!js_options["blockSize"].isUndefined())
+            block_size = js_options["blockSize"].as<double>();
+        if (!js_options["maxMem"].isUndefined())
+            max_mem = js_options["maxMem"].as<double>();
+    }
+
+    if (!(size >= 0) || !(block_size >= 1) || !(max_mem >= 0))
+        throw std::invalid_argument(
+            "size, block size and memory budget must be positive");
+
+    RangeCache *cache = new RangeCache;
+    cache->fetch = add_function<FetchCallback>(fetch_range, "pdd");
+    cache->size = static_cast<int64_t>(size);
+    cache->block_size = static_cast<int64_t>(block_size);
+    // always keep at least the block we are reading from
+    cache->max_blocks =
+        std::max<size_t>(1, static_cast<size_t>(max_mem / block_size));
+
+    VipsSourceCustom *source = vips_source_custom_new();
+    g_object_set_data_full(G_OBJECT(source), RANGES_KEY, cache,
+                           [](gpointer data) {
+                               delete static_cast<RangeCache *>(data);
+                           });
+    g_signal_connect(source, "read", G_CALLBACK(ranges_read_handler), cache);
+    g_signal_connect(source, "seek", G_CALLBACK(ranges_seek_handler), cache);
+
+    return SourceRanges(VIPS_SOURCE(source));
+}
+
+RangeStats SourceRanges::stats() const {
+    RangeCache *cache = get_object() == nullptr
+                            ? nullptr
+                            : static_cast<RangeCache *>(g_object_get_data(
+                                  G_OBJECT(get_object()), RANGES_KEY));
+    if (cache == nullptr)
+        return {0, 0, 0, 0, 0, 0, 0};
+
+    int hits = cache->hits;
+    int misses = cache->misses;
+
+    return {cache->n_blocks,
+            static_cast<double>(cache->mem),
+            hits,
+            misses,
+            cache->fetches,
+            static_cast<double>(cache->bytes_fetched),
+            hits + misses > 0 ? static_cast<double>(hits) / (hits + misses)
+                              : 0};
 }
 
 Target Target::new_to_file(const std::string &filename) {
@@ -122,7 +570,7 @@ int64_t TargetCustom::read_handler(VipsTargetCustom *target, void *data,
     int64_t bytes_read = 0;
     proxy_sync([&]() {
         emscripten::val val = emscripten::val::take_ownership(
-            self->read_callback(static_cast<int>(length)));
+            self->read_callback(static_cast<double>(length)));
         if (val.isUndefined())
             return;
 
@@ -144,7 +592,8 @@ int64_t TargetCustom::seek_handler(VipsTargetCustom *target, int64_t offset,
 
     int64_t new_pos;
     proxy_sync([&]() {
-        new_pos = self->seek_callback(static_cast<int>(offset), whence);
+        double pos = self->seek_callback(static_cast<double>(offset), whence);
+        new_pos = to_position(pos);
     });
 
     return new_pos;
@@ -164,27 +613,19 @@ int TargetCustom::end_handler(VipsTargetCustom *target, void *user) {
 }
 
 void TargetCustom::set_write_callback(emscripten::val js_func) {
-    emscripten::val ptr = emscripten::val::module_property("addFunction")(
-        js_func, emscripten::val("ii"));
-    write_callback = reinterpret_cast<WriteCallback>(ptr.as<int>());
+    write_callback = add_function<WriteCallback>(js_func, "ip");
 }
 
 void TargetCustom::set_read_callback(emscripten::val js_func) {
-    emscripten::val ptr = emscripten::val::module_property("addFunction")(
-        js_func, emscripten::val("ii"));
-    read_callback = reinterpret_cast<ReadCallback>(ptr.as<int>());
+    read_callback = add_function<ReadCallback>(js_func, "pd");
 }
 
 void TargetCustom::set_seek_callback(emscripten::val js_func) {
-    emscripten::val ptr = emscripten::val::module_property("addFunction")(
-        js_func, emscripten::val("iii"));
-    seek_callback = reinterpret_cast<SeekCallback>(ptr.as<int>());
+    seek_callback = add_function<SeekCallback>(js_func, "ddi");
 }
 
 void TargetCustom::set_end_callback(emscripten::val js_func) {
-    emscripten::val ptr = emscripten::val::module_property("addFunction")(
-        js_func, emscripten::val("i"));
-    end_callback = reinterpret_cast<EndCallback>(ptr.as<int>());
+    end_callback = add_function<EndCallback>(js_func, "i");
 }
 
 }  // namespace vips
@@ -3,6 +3,7 @@
 #include "object.h"
 #include "utils.h"
 
+#include <memory>
 #include <optional>
 #include <string>
 
@@ -10,13 +11,56 @@
 
 namespace vips {
 
-// sig = ii
-using ReadCallback = emscripten::EM_VAL (*)(int length);
+// Lengths and offsets are passed as doubles, so that they don't overflow
+// beyond 2 GiB. JS numbers are exact up to 2^53.
+
+// sig = pd
+using ReadCallback = emscripten::EM_VAL (*)(double length);
+// sig = ip
 using WriteCallback = int (*)(emscripten::EM_VAL data);
-// sig = iii
-using SeekCallback = int (*)(int offset, int whence);
+// sig = ddi
+using SeekCallback = double (*)(double offset, int whence);
 // sig = i
 using EndCallback = int (*)();
+// sig = pdd
+using FetchCallback = emscripten::EM_VAL (*)(double offset, double length);
+
+struct ReadAheadStats {
+    // calls to the read handler
+    int fetches;
+
+    // bytes returned by the read handler
+    double bytes_fetched;
+
+    // reads that had to wait for the read handler
+    int stalls;
+
+    // milliseconds spent waiting for the read handler
+    double stall_time;
+};
+
+struct RangeStats {
+    // number of cached blocks
+    int blocks;
+
+    // bytes held by the cached blocks
+    double mem;
+
+    // blocks that were read from the cache
+    int hits;
+
+    // blocks that had to be fetched
+    int misses;
+
+    // calls to the fetch function, adjacent missing blocks are coalesced
+    int fetches;
+
+    // bytes returned by the fetch function
+    double bytes_fetched;
+
+    // hits / (hits + misses)
+    double hit_ratio;
+};
 
 class Connection : public Object {
  public:
@@ -78,6 +122,18 @@ class SourceCustom : public Source {
 
     void set_seek_callback(emscripten::val js_func);
 
+    size_t get_read_ahead() const;
+
+    /**
+     * Read ahead of a sequential decoder. While the decoder consumes the
+     * buffered bytes, the next `window` bytes are requested from the read
+     * handler on the main thread, so that I/O latency overlaps with
+     * decoding. 0 (the default) reads exactly what libvips asks for.
+     */
+    void set_read_ahead(size_t window);
+
+    ReadAheadStats stats() const;
+
     emscripten::val stub_getter() const {
         return emscripten::val::null();
     }
@@ -87,8 +143,36 @@ class SourceCustom : public Source {
     }
 
  private:
+    struct ReadAhead;
+
     ReadCallback read_callback = nullptr;
     SeekCallback seek_callback = nullptr;
+
+    // shared with the reads in flight, which may outlive us
+    std::shared_ptr<ReadAhead> read_ahead;
+};
+
+/**
+ * A random access source over a JS function that fetches byte ranges, for
+ * example with HTTP range requests.
+ *
+ * The source is split into fixed-size blocks that are kept in an LRU with
+ * a byte budget, so that loaders of tiled formats only fetch the tiles they
+ * touch. A read fetches all its missing blocks, with a single call for each
+ * run of adjacent blocks.
+ */
+class SourceRanges : public Source {
+ public:
+    explicit SourceRanges(VipsSource *input) : Source(input) {}
+
+    // an empty (NULL) SourceRanges, eg. "SourceRanges a;"
+    SourceRanges() : Source(nullptr) {}
+
+    static SourceRanges new_from_ranges(emscripten::val fetch_range,
+                                        double size,
+                                        emscripten::val js_options);
+
+    RangeStats stats() const;
 };
 
 class Target : public Connection {
@@ -0,0 +1,204 @@
+#include "framepool.h"
+#include "error.h"
+#include "option.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vips {
+
+FramePool::State::~State() {
+    for (Buffer &buffer : buffers) {
+        free(buffer.data);
+        g_weak_ref_clear(&buffer.image);
+    }
+}
+
+FramePool::FramePool(int width, int height, int bands, emscripten::val format,
+                     int count)
+    : state(std::make_shared<State>()) {
+    if (width <= 0 || height <= 0 || bands <= 0 || count <= 0)
+        throw std::invalid_argument("frame pool dimensions must be positive");
+
+    state->width = width;
+    state->height = height;
+    state->bands = bands;
+    state->format = static_cast<VipsBandFormat>(
+        Option::to_enum(VIPS_TYPE_BAND_FORMAT, format));
+    state->size = static_cast<size_t>(width) * height * bands *
+                  vips_format_sizeof(state->format);
+
+    state->buffers = std::vector<Buffer>(count);
+    for (Buffer &buffer : state->buffers) {
+        g_weak_ref_init(&buffer.image, nullptr);
+
+        buffer.data = malloc(state->size);
+        if (buffer.data == nullptr)
+            throw Error("unable to allocate frame pool");
+    }
+}
+
+int FramePool::available() const {
+    std::lock_guard<std::mutex> lock(state->lock);
+
+    return static_cast<int>(std::count_if(
+        state->buffers.begin(), state->buffers.end(), [](const Buffer &b) {
+            return b.state == BufferState::FREE;
+        }));
+}
+
+FramePool::Buffer *FramePool::find(uintptr_t ptr) const {
+    void *data = reinterpret_cast<void *>(ptr);
+
+    for (Buffer &buffer : state->buffers)
+        if (buffer.data == data)
+            return &buffer;
+
+    throw std::invalid_argument("buffer is not part of this pool");
+}
+
+FramePool::Buffer *FramePool::take_free() {
+    std::lock_guard<std::mutex> lock(state->lock);
+
+    for (Buffer &buffer : state->buffers)
+        if (buffer.state == BufferState::FREE) {
+            buffer.state = BufferState::LEASED;
+            return &buffer;
+        }
+
+    return nullptr;
+}
+
+void FramePool::drop_cached_images() {
+    std::vector<VipsImage *> images;
+    {
+        std::lock_guard<std::mutex> lock(state->lock);
+
+        for (Buffer &buffer : state->buffers) {
+            if (buffer.state != BufferState::WRAPPED)
+                continue;
+
+            // the image might be closing, the weak ref gives us a
+            // reference only if it isn't
+            if (gpointer image = g_weak_ref_get(&buffer.image))
+                images.push_back(static_cast<VipsImage *>(image));
+        }
+    }
+
+    // This removes the operations that use the image, and the images
+    // made from it, from the libvips operation cache. Images that were
+    // only kept alive by the cache are closed when we unref them, which
+    // gives their buffer back.
+    for (VipsImage *image : images) {
+        vips_image_invalidate_all(image);
+        g_object_unref(image);
+    }
+}
+
+uintptr_t FramePool::acquire() {
+    Buffer *buffer = take_free();
+
+    if (buffer == nullptr) {
+        drop_cached_images();
+        buffer = take_free();
+    }
+
+    if (buffer == nullptr)
+        throw std::runtime_error("no free buffers in frame pool");
+
+    return reinterpret_cast<uintptr_t>(buffer->data);
+}
+
+void FramePool::release(uintptr_t ptr) {
+    Buffer *buffer = find(ptr);
+
+    std::lock_guard<std::mutex> lock(state->lock);
+
+    if (buffer->state == BufferState::WRAPPED)
+        throw std::invalid_argument(
+            "buffer is wrapped in an image, it's given back when the image "
+            "is closed");
+    if (buffer->state == BufferState::FREE)
+        throw std::invalid_argument("buffer was not acquired");
+
+    buffer->state = BufferState::FREE;
+}
+
+emscripten::val FramePool::view(uintptr_t ptr) const {
+    Buffer *buffer = find(ptr);
+
+    return to_typed_array(state->format, buffer->data, state->size, false);
+}
+
+void FramePool::image_postclose(VipsImage *image, Lease *lease) {
+    {
+        std::lock_guard<std::mutex> lock(lease->state->lock);
+
+        g_weak_ref_set(&lease->buffer->image, nullptr);
+        lease->buffer->state = BufferState::FREE;
+    }
+
+    delete lease;
+}
+
+Image FramePool::image(uintptr_t ptr) {
+    Buffer *buffer = find(ptr);
+
+    {
+        std::lock_guard<std::mutex> lock(state->lock);
+
+        if (buffer->state == BufferState::WRAPPED)
+            throw std::invalid_argument(
+                "buffer is already wrapped in an image");
+        if (buffer->state == BufferState::FREE)
+            throw std::invalid_argument("buffer was not acquired");
+
+        buffer->state = BufferState::WRAPPED;
+    }
+
+    VipsImage *image =
+        vips_image_new_from_memory(buffer->data, state->size, state->width,
+                                   state->height, state->bands, state->format);
+
+    if (image == nullptr) {
+        std::lock_guard<std::mutex> lock(state->lock);
+        buffer->state = BufferState::LEASED;
+        throw Error("unable to make image from frame pool");
+    }
+
+    g_weak_ref_set(&buffer->image, image);
+    g_signal_connect(image, "postclose", G_CALLBACK(image_postclose),
+                     new Lease{state, buffer});
+
+    return Image(image);
+}
+
+uintptr_t FramePool::write(const Image &image) {
+    VipsImage *in = image.get_image();
+
+    if (in->Xsize != state->width || in->Ysize != state->height ||
+        in->Bands != state->bands || in->BandFmt != state->format)
+        throw std::invalid_argument(
+            "image does not match the size and format of the frame pool");
+
+    uintptr_t ptr = acquire();
+    Buffer *buffer = find(ptr);
+
+    VipsImage *out =
+        vips_image_new_from_memory(buffer->data, state->size, state->width,
+                                   state->height, state->bands, state->format);
+
+    if (out == nullptr || vips_image_write(in, out)) {
+        if (out != nullptr)
+            g_object_unref(out);
+        release(ptr);
+        throw Error("unable to write to frame pool");
+    }
+
+    g_object_unref(out);
+
+    return ptr;
+}
+
+}  // namespace vips
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "image.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <emscripten/val.h>
+
+#include <vips/vips.h>
+
+namespace vips {
+
+/**
+ * A fixed set of equally sized pixel buffers on the Wasm heap, for frame
+ * loops that would otherwise allocate new input and output buffers for
+ * every frame.
+ *
+ * Buffers are handed out by address. An image made with image() gives its
+ * buffer back to the pool when it's closed, other buffers are given back
+ * with release(). The buffers are freed once the pool and all images made
+ * from it are gone.
+ *
+ * Cached operations keep their input images alive, so when the pool runs
+ * out, acquire() first drops the cached operations that use an image made
+ * from the pool.
+ */
+class FramePool {
+ public:
+    // an empty pool, eg. "FramePool a;"
+    FramePool() : state(std::make_shared<State>()) {}
+
+    FramePool(int width, int height, int bands, emscripten::val format,
+              int count);
+
+    int width() const {
+        return state->width;
+    }
+
+    int height() const {
+        return state->height;
+    }
+
+    int bands() const {
+        return state->bands;
+    }
+
+    int count() const {
+        return static_cast<int>(state->buffers.size());
+    }
+
+    // the size of a buffer in bytes
+    size_t size() const {
+        return state->size;
+    }
+
+    // the number of buffers that are not in use
+    int available() const;
+
+    /**
+     * Take a free buffer from the pool, returns its address.
+     */
+    uintptr_t acquire();
+
+    /**
+     * Give an acquired buffer back to the pool. Buffers wrapped in an
+     * image can't be released, they are given back when the image is
+     * closed.
+     */
+    void release(uintptr_t ptr);
+
+    /**
+     * A typed array view on a buffer, matching the band format.
+     */
+    emscripten::val view(uintptr_t ptr) const;
+
+    /**
+     * Wrap an acquired buffer in an image, a buffer can only be wrapped
+     * once. The buffer is given back to the pool when the image is closed.
+     */
+    Image image(uintptr_t ptr);
+
+    /**
+     * Render an image, which must have the size and format of the pool,
+     * into a free buffer and return its address.
+     */
+    uintptr_t write(const Image &image);
+
+ private:
+    enum class BufferState { FREE, LEASED, WRAPPED };
+
+    struct Buffer {
+        void *data = nullptr;
+        BufferState state = BufferState::FREE;
+
+        // the image made by image(), while WRAPPED
+        GWeakRef image;
+    };
+
+    struct State {
+        int width = 0;
+        int height = 0;
+        int bands = 0;
+        VipsBandFormat format = VIPS_FORMAT_UCHAR;
+        size_t size = 0;
+
+        // never resized once made, the weak refs must stay in place
+        std::vector<Buffer> buffers;
+
+        // images can be closed on any thread
+        std::mutex lock;
+
+        ~State();
+    };
+
+    struct Lease {
+        std::shared_ptr<State> state;
+        Buffer *buffer;
+    };
+
+    static void image_postclose(VipsImage *image, Lease *lease);
+
+    Buffer *find(uintptr_t ptr) const;
+
+    Buffer *take_free();
+
+    void drop_cached_images();
+
+    std::shared_ptr<State> state;
+};
+
+}  // namespace vips
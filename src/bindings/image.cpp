@@ -1,5 +1,19 @@
 #include "image.h"
 
+#include "cache.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <mutex>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <emscripten/threading.h>
+
 /*
 #define VIPS_DEBUG
 #define VIPS_DEBUG_VERBOSE
@@ -70,6 +84,7 @@ void Image::call(const char *operation_name, const char *option_string,
         args->set_operation(operation);
 
     // Build from cache.
+    const VipsOperation *original = operation;
     if (vips_cache_operation_buildp(&operation)) {
         vips_object_unref_outputs(VIPS_OBJECT(operation));
         g_object_unref(operation);
@@ -77,6 +92,18 @@ void Image::call(const char *operation_name, const char *option_string,
         throw Error("unable to call " + std::string(operation_name));
     }
 
+    OperationCache::track(original, operation);
+
+    // The adaptive policy and the result cache are main thread only, see
+    // cache.h. Calls from worker threads, eg. by the Scheduler, skip them.
+    if (emscripten_is_main_runtime_thread()) {
+        AdaptiveCache::update();
+
+        // Remember how the outputs were made, if the result cache is
+        // enabled.
+        ResultCache::tag(operation);
+    }
+
     // Walk args again, writing output.
     if (args)
         args->get_operation(operation, kwargs);
@@ -109,9 +136,7 @@ void Image::eval_handler(VipsImage *image, VipsProgress *progress, void *user) {
 }
 
 void Image::set_progress_callback(emscripten::val js_func) {
-    emscripten::val ptr = emscripten::val::module_property("addFunction")(
-        js_func, emscripten::val("vi"));
-    progress_callback = reinterpret_cast<void (*)(int)>(ptr.as<int>());
+    progress_callback = add_function<void (*)(int)>(js_func, "vi");
 
     vips_image_set_progress(get_image(), 1);
     g_signal_connect(get_image(), "eval", G_CALLBACK(eval_handler), this);
@@ -142,12 +167,24 @@ Image Image::new_from_file(const std::string &name,
     if (operation_name == nullptr)
         throw Error("unable to load from file " + std::string(filename));
 
+    std::string key = DecodeCache::key_file(filename, operation_name,
+                                            option_string, js_options);
+    if (!key.empty()) {
+        if (VipsImage *cached = DecodeCache::lookup(key))
+            return Image(cached);
+    }
+
     Image out;
 
     Image::call(operation_name, option_string,
                 (new Option)->set("filename", filename)->set("out", &out),
                 js_options);
 
+    if (!key.empty()) {
+        if (VipsImage *cached = DecodeCache::insert(key, out.get_image()))
+            return Image(cached);
+    }
+
     return out;
 }
 
@@ -164,83 +201,219 @@ Image Image::new_from_memory(emscripten::val data, int width, int height,
             vips_enum_nick(VIPS_TYPE_BAND_FORMAT, band_format) + "'");
     }
 
-    VipsImage *image;
+    size_t size = data["byteLength"].as<size_t>();
+    void *mem = malloc(size);
 
-    switch (band_format) {
-        case VIPS_FORMAT_UCHAR: {
-            std::vector<u_int8_t> v =
-                emscripten::convertJSArrayToNumberVector<u_int8_t>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(u_int8_t) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        case VIPS_FORMAT_CHAR: {
-            std::vector<int8_t> v =
-                emscripten::convertJSArrayToNumberVector<int8_t>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(int8_t) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        case VIPS_FORMAT_USHORT: {
-            std::vector<u_int16_t> v =
-                emscripten::convertJSArrayToNumberVector<u_int16_t>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(u_int16_t) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        case VIPS_FORMAT_SHORT: {
-            std::vector<int16_t> v =
-                emscripten::convertJSArrayToNumberVector<int16_t>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(int16_t) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        case VIPS_FORMAT_UINT: {
-            std::vector<u_int32_t> v =
-                emscripten::convertJSArrayToNumberVector<u_int32_t>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(u_int32_t) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        case VIPS_FORMAT_INT: {
-            std::vector<int32_t> v =
-                emscripten::convertJSArrayToNumberVector<int32_t>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(int32_t) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        case VIPS_FORMAT_FLOAT: {
-            std::vector<float> v =
-                emscripten::convertJSArrayToNumberVector<float>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(float) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        case VIPS_FORMAT_DOUBLE: {
-            std::vector<double> v =
-                emscripten::convertJSArrayToNumberVector<double>(data);
-            image = vips_image_new_from_memory_copy(
-                v.data(), sizeof(double) * v.size(), width, height, bands,
-                band_format);
-            break;
-        }
-        default:
-            throw std::invalid_argument("band format unsupported");
+    if (mem == nullptr)
+        throw Error("unable to allocate memory for image");
+
+    // A view of the image memory with the typed array type of the band
+    // format, this throws for complex formats.
+    emscripten::val view;
+    try {
+        view = to_typed_array(band_format, mem, size, false);
+    } catch (...) {
+        free(mem);
+        throw;
     }
 
-    if (image == nullptr)
+    // Take a single copy, straight from the JS array into memory that the
+    // image owns. The bytes are copied as is when the types match,
+    // otherwise set() converts the values.
+    if (data["constructor"].strictlyEquals(view["constructor"]))
+        emscripten::val(
+            emscripten::typed_memory_view(size, static_cast<uint8_t *>(mem)))
+            .call<void>("set", BlobVal.new_(data["buffer"],
+                                            data["byteOffset"],
+                                            data["byteLength"]));
+    else
+        view.call<void>("set", data);
+
+    return new_from_memory_owned(reinterpret_cast<uintptr_t>(mem), size,
+                                 width, height, bands, band_format);
+}
+
+static void free_owned_memory(VipsImage *image, void *data) {
+    free(data);
+}
+
+Image Image::new_from_memory_owned(uintptr_t data, size_t size, int width,
+                                   int height, int bands,
+                                   VipsBandFormat format) {
+    void *mem = reinterpret_cast<void *>(data);
+    VipsImage *image = vips_image_new_from_memory(mem, size, width, height,
+                                                  bands, format);
+
+    if (image == nullptr) {
+        free(mem);
         throw Error("unable to make image from memory");
+    }
+
+    g_signal_connect(image, "postclose", G_CALLBACK(free_owned_memory), mem);
 
     return Image(image);
 }
 
+// Read a region of a file into newly allocated memory. On Node.js, each
+// read() is a single fs.readSync() straight into the Wasm heap, we only
+// loop for regions that are larger than a single read can handle.
+static void *read_file_region(const std::string &filename, off_t offset,
+                              size_t size) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        vips_error_system(errno, "newFromFileMapped", "unable to open \"%s\"",
+                          filename.c_str());
+        return nullptr;
+    }
+
+    void *mem = malloc(size);
+    if (mem == nullptr) {
+        close(fd);
+        vips_error("newFromFileMapped", "unable to allocate %zu bytes", size);
+        return nullptr;
+    }
+
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, static_cast<char *>(mem) + done, size - done,
+                          offset + done);
+        if (n <= 0) {
+            if (n == -1)
+                vips_error_system(errno, "newFromFileMapped",
+                                  "unable to read \"%s\"", filename.c_str());
+            else
+                vips_error("newFromFileMapped", "file \"%s\" is truncated",
+                           filename.c_str());
+
+            free(mem);
+            close(fd);
+            return nullptr;
+        }
+        done += n;
+    }
+
+    close(fd);
+
+    return mem;
+}
+
+// The size in bytes of an image, or 0 if the layout is invalid or the size
+// doesn't fit in a size_t.
+static size_t image_size(int width, int height, int bands,
+                         VipsBandFormat format) {
+    if (width <= 0 || height <= 0 || bands <= 0 ||
+        format <= VIPS_FORMAT_NOTSET || format >= VIPS_FORMAT_LAST)
+        return 0;
+
+    size_t size = vips_format_sizeof_unsafe(format);
+    for (int n : {bands, width, height}) {
+        if (size > SIZE_MAX / n)
+            return 0;
+        size *= n;
+    }
+
+    return size;
+}
+
+static void *copy_metadata(VipsImage *image, const char *field, GValue *value,
+                           void *a) {
+    VipsImage *out = static_cast<VipsImage *>(a);
+
+    // Built-in fields are properties, these were set from the header
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(image), field) ==
+        nullptr)
+        vips_image_set(out, field, value);
+
+    return nullptr;
+}
+
+Image Image::new_from_file_mapped(const std::string &filename,
+                                  emscripten::val js_options) {
+    if (!js_options.isNull() && !js_options.isUndefined() &&
+        !js_options["width"].isUndefined()) {
+        int width = js_options["width"].as<int>();
+        int height = js_options["height"].as<int>();
+        int bands = js_options["bands"].as<int>();
+        VipsBandFormat format = static_cast<VipsBandFormat>(
+            Option::to_enum(VIPS_TYPE_BAND_FORMAT, js_options["format"]));
+        double offset = js_options["offset"].isUndefined()
+                            ? 0
+                            : js_options["offset"].as<double>();
+
+        size_t size = image_size(width, height, bands, format);
+        if (size == 0)
+            throw std::invalid_argument("bad image layout");
+        if (!std::isfinite(offset) || offset < 0 ||
+            offset >= static_cast<double>(std::numeric_limits<off_t>::max()))
+            throw std::invalid_argument("bad offset");
+
+        void *mem =
+            read_file_region(filename, static_cast<off_t>(offset), size);
+        if (mem == nullptr)
+            throw Error("unable to load from file " + filename);
+
+        return new_from_memory_owned(reinterpret_cast<uintptr_t>(mem), size,
+                                     width, height, bands, format);
+    }
+
+    // Anything but a vips-format file needs decoding.
+    const char *loader = vips_foreign_find_load(filename.c_str());
+    if (loader == nullptr)
+        throw Error("unable to load from file " + filename);
+    if (!g_type_is_a(g_type_from_name(loader),
+                     g_type_from_name("VipsForeignLoadVips")))
+        return new_from_file(filename);
+
+    // Only the header and the extension block are read here.
+    VipsImage *header = vips_image_new_mode(filename.c_str(), "r");
+    if (header == nullptr)
+        throw Error("unable to load from file " + filename);
+
+    // Files with the other byte order must be swapped on load, and coded
+    // images keep their coding, let libvips handle both.
+    if (vips_image_isMSBfirst(header) != vips_amiMSBfirst() ||
+        header->Coding != VIPS_CODING_NONE) {
+        g_object_unref(header);
+        return new_from_file(filename);
+    }
+
+    size_t size = image_size(header->Xsize, header->Ysize, header->Bands,
+                             header->BandFmt);
+    if (size == 0) {
+        g_object_unref(header);
+        throw std::invalid_argument("image too large for memory");
+    }
+
+    void *mem = read_file_region(
+        filename, static_cast<off_t>(header->sizeof_header), size);
+    if (mem == nullptr) {
+        g_object_unref(header);
+        throw Error("unable to load from file " + filename);
+    }
+
+    Image out;
+    try {
+        out = new_from_memory_owned(reinterpret_cast<uintptr_t>(mem), size,
+                                    header->Xsize, header->Ysize,
+                                    header->Bands, header->BandFmt);
+    } catch (...) {
+        g_object_unref(header);
+        throw;
+    }
+
+    VipsImage *image = out.get_image();
+    image->Type = header->Type;
+    image->Xres = header->Xres;
+    image->Yres = header->Yres;
+    image->Xoffset = header->Xoffset;
+    image->Yoffset = header->Yoffset;
+    (void) vips_image_map(header, copy_metadata, image);
+
+    g_object_unref(header);
+
+    return out;
+}
+
 Image Image::new_from_memory(uintptr_t data, size_t size, int width, int height,
                              int bands, emscripten::val format) {
     // A non-copy alternative.
@@ -264,6 +437,14 @@ Image Image::new_from_buffer(const std::string &buffer,
     if (operation_name == nullptr)
         throw Error("unable to load from buffer");
 
+    std::string key =
+        DecodeCache::key_buffer(buffer.c_str(), buffer.size(), operation_name,
+                                option_string.c_str(), js_options);
+    if (!key.empty()) {
+        if (VipsImage *cached = DecodeCache::lookup(key))
+            return Image(cached);
+    }
+
     Image out;
 
     // We must take a copy of the data.
@@ -273,6 +454,11 @@ Image Image::new_from_buffer(const std::string &buffer,
 
     Image::call(operation_name, option_string.c_str(), options, js_options);
 
+    if (!key.empty()) {
+        if (VipsImage *cached = DecodeCache::insert(key, out.get_image()))
+            return Image(cached);
+    }
+
     return out;
 }
 
@@ -298,11 +484,38 @@ Image Image::new_matrix(int width, int height) {
     return Image(vips_image_new_matrix(width, height));
 }
 
+// Make a matrix image and copy a JS array or typed array straight into its
+// pixels, with a single TypedArray.prototype.set() call.
+static VipsImage *new_matrix_from_js(int width, int height,
+                                     emscripten::val array) {
+    int size = array["length"].as<int>();
+    if (size != width * height) {
+        vips_error("VipsImage", "bad array length --- should be %d, you "
+                   "passed %d", width * height, size);
+        return nullptr;
+    }
+
+    VipsImage *image = vips_image_new_matrix(width, height);
+    if (image == nullptr)
+        return nullptr;
+
+    emscripten::val(emscripten::typed_memory_view(
+                        static_cast<size_t>(width) * height,
+                        VIPS_MATRIX(image, 0, 0)))
+        .call<void>("set", array);
+
+    return image;
+}
+
 Image Image::new_matrix(int width, int height, emscripten::val array) {
-    std::vector<double> v = to_vector<double>(array);
+    VipsImage *image;
 
-    VipsImage *image = vips_image_new_matrix_from_array(
-        width, height, v.data(), static_cast<int>(v.size()));
+    if (array.isArray() || is_typed_array(array)) {
+        image = new_matrix_from_js(width, height, array);
+    } else {
+        double value = array.as<double>();
+        image = vips_image_new_matrix_from_array(width, height, &value, 1);
+    }
 
     if (image == nullptr)
         throw Error("unable to make image from matrix");
@@ -312,39 +525,23 @@ Image Image::new_matrix(int width, int height, emscripten::val array) {
 
 Image Image::new_from_array(emscripten::val array, double scale,
                             double offset) {
-    std::vector<double> v;
-
-    int width;
-    int height;
-
-    if (is_2D(array)) {
-        width = array[0]["length"].as<int>();
-        height = array["length"].as<int>();
-
-        v.resize(width * height);
-
-        for (int y = 0; y < height; ++y)
-            for (int x = 0; x < width; ++x)
-                v[x + y * width] = array[y][x].as<double>();
-    } else if (array.isArray()) {
-        width = array["length"].as<int>();
-        height = 1;
+    VipsImage *image;
 
-        v.reserve(width);
+    int width = width_2D(array);
 
-        for (int x = 0; x < width; ++x)
-            v.push_back(array[x].as<double>());
+    if (width >= 0) {
+        // Flatten on the JS side, so that we can copy all values at once
+        image = new_matrix_from_js(width, array["length"].as<int>(),
+                                   array.call<emscripten::val>("flat"));
+    } else if (array.isArray() || is_typed_array(array)) {
+        image = new_matrix_from_js(array["length"].as<int>(), 1, array);
     } else {
         // Allow single pixels/images (for e.g.
         // `vips.Image.newFromArray(127.5)`).
-        v = {array.as<double>()};
-        width = 1;
-        height = 1;
+        double value = array.as<double>();
+        image = vips_image_new_matrix_from_array(1, 1, &value, 1);
     }
 
-    VipsImage *image = vips_image_new_matrix_from_array(width, height, v.data(),
-                                                        width * height);
-
     if (image == nullptr)
         throw Error("unable to make image from array");
 
@@ -366,6 +563,72 @@ Image Image::new_from_image(emscripten::val pixel) const {
     return Image(image);
 }
 
+/**
+ * A small LRU of the constant images made by imageize(). Arithmetic with
+ * constants tends to use the same few values over and over, and reusing
+ * the image avoids building it again and lets the operation cache hit for
+ * the operations it's passed to.
+ */
+struct ConstantImage {
+    std::vector<double> values;
+
+    // the properties vips_image_new_from_image() takes from the match image
+    int width;
+    int height;
+    VipsBandFormat format;
+    VipsInterpretation interpretation;
+    double xres;
+    double yres;
+    int xoffset;
+    int yoffset;
+
+    Image image;
+};
+
+static const size_t max_constant_images = 32;
+static std::mutex constant_images_lock;
+static std::list<ConstantImage> constant_images;
+
+Image Image::new_from_constant(const std::vector<double> &values) const {
+    VipsImage *match = get_image();
+
+    std::lock_guard<std::mutex> lock(constant_images_lock);
+
+    for (auto it = constant_images.begin(); it != constant_images.end();
+         ++it) {
+        if (it->values == values && it->width == match->Xsize &&
+            it->height == match->Ysize && it->format == match->BandFmt &&
+            it->interpretation == match->Type && it->xres == match->Xres &&
+            it->yres == match->Yres && it->xoffset == match->Xoffset &&
+            it->yoffset == match->Yoffset) {
+            constant_images.splice(constant_images.begin(), constant_images,
+                                   it);
+            return it->image;
+        }
+    }
+
+    VipsImage *image = vips_image_new_from_image(
+        match, values.data(), static_cast<int>(values.size()));
+
+    if (image == nullptr)
+        throw Error("unable to make image from image");
+
+    constant_images.push_front({values, match->Xsize, match->Ysize,
+                                match->BandFmt, match->Type, match->Xres,
+                                match->Yres, match->Xoffset, match->Yoffset,
+                                Image(image)});
+    if (constant_images.size() > max_constant_images)
+        constant_images.pop_back();
+
+    return constant_images.front().image;
+}
+
+void Image::clear_constant_images() {
+    std::lock_guard<std::mutex> lock(constant_images_lock);
+
+    constant_images.clear();
+}
+
 Image Image::imageize(emscripten::val v, const Image *match_image) {
     if (match_image)
         return match_image->imageize(v);
@@ -379,7 +642,7 @@ Image Image::imageize(emscripten::val v) const {
     if (is_2D(v))
         return Image::new_from_array(v);
 
-    return new_from_image(v);
+    return new_from_constant(to_vector<double>(v));
 }
 
 std::vector<Image> Image::imageize_vector(emscripten::val v,
@@ -454,8 +717,8 @@ void Image::write_to_file(const std::string &name,
                 js_options);
 }
 
-emscripten::val Image::write_to_buffer(const std::string &suffix,
-                                       emscripten::val js_options) const {
+VipsBlob *Image::write_to_blob(const std::string &suffix,
+                               emscripten::val js_options) const {
     char filename[VIPS_PATH_MAX];
     char option_string[VIPS_PATH_MAX];
     const char *operation_name;
@@ -488,6 +751,22 @@ emscripten::val Image::write_to_buffer(const std::string &suffix,
         throw Error("unable to write to buffer");
     }
 
+    // our caller gets a reference
+    return blob;
+}
+
+emscripten::val Image::write_to_buffer(const std::string &suffix,
+                                       emscripten::val js_options) const {
+    std::string key = ResultCache::key(*this, suffix, js_options);
+
+    VipsBlob *blob = key.empty() ? nullptr : ResultCache::lookup(key);
+    if (blob == nullptr) {
+        blob = write_to_blob(suffix, js_options);
+
+        if (!key.empty())
+            ResultCache::insert(key, blob);
+    }
+
     emscripten::val result = BlobVal.new_(emscripten::typed_memory_view(
         VIPS_AREA(blob)->length,
         static_cast<uint8_t *>(VIPS_AREA(blob)->data)));
@@ -522,64 +801,127 @@ emscripten::val Image::write_to_memory() const {
 
     emscripten::val result;
 
-    switch (vips_image_get_format(get_image())) {
-        case VIPS_FORMAT_UCHAR:
-            result = BlobVal.new_(emscripten::typed_memory_view(
-                size / sizeof(u_int8_t), static_cast<uint8_t *>(mem)));
-            break;
-        case VIPS_FORMAT_CHAR:
-            result =
-                emscripten::val::global("Int8Array")
-                    .new_(emscripten::typed_memory_view(
-                        size / sizeof(int8_t), static_cast<int8_t *>(mem)));
-            break;
-        case VIPS_FORMAT_USHORT:
-            result = emscripten::val::global("Uint16Array")
-                         .new_(emscripten::typed_memory_view(
-                             size / sizeof(u_int16_t),
-                             static_cast<u_int16_t *>(mem)));
-            break;
-        case VIPS_FORMAT_SHORT:
-            result =
-                emscripten::val::global("Int16Array")
-                    .new_(emscripten::typed_memory_view(
-                        size / sizeof(int16_t), static_cast<int16_t *>(mem)));
-            break;
-
-        case VIPS_FORMAT_UINT:
-            result = emscripten::val::global("Uint32Array")
-                         .new_(emscripten::typed_memory_view(
-                             size / sizeof(u_int32_t),
-                             static_cast<u_int32_t *>(mem)));
-            break;
-
-        case VIPS_FORMAT_INT:
-            result =
-                emscripten::val::global("Int32Array")
-                    .new_(emscripten::typed_memory_view(
-                        size / sizeof(int32_t), static_cast<int32_t *>(mem)));
-            break;
-        case VIPS_FORMAT_FLOAT:
-            result = emscripten::val::global("Float32Array")
-                         .new_(emscripten::typed_memory_view(
-                             size / sizeof(float), static_cast<float *>(mem)));
-            break;
-
-        case VIPS_FORMAT_DOUBLE:
-            result =
-                emscripten::val::global("Float64Array")
-                    .new_(emscripten::typed_memory_view(
-                        size / sizeof(double), static_cast<double *>(mem)));
-            break;
-        default:
-            g_free(mem);
-            throw std::invalid_argument("band format unsupported");
+    try {
+        result = to_typed_array(vips_image_get_format(get_image()), mem, size);
+    } catch (...) {
+        g_free(mem);
+        throw;
     }
 
     g_free(mem);
     return result;
 }
 
+void Image::write_to_memory(uintptr_t ptr, size_t size) const {
+    VipsImage *image = get_image();
+
+    if (size < VIPS_IMAGE_SIZEOF_IMAGE(image))
+        throw std::invalid_argument("memory area too small for image");
+
+    VipsImage *out = vips_image_new_from_memory(
+        reinterpret_cast<void *>(ptr), size, image->Xsize, image->Ysize,
+        image->Bands, image->BandFmt);
+
+    if (out == nullptr)
+        throw Error("unable to write to memory");
+
+    int result = vips_image_write(image, out);
+    g_object_unref(out);
+
+    if (result)
+        throw Error("unable to write to memory");
+}
+
+Image Image::rgba8() const {
+    Image im = *this;
+    VipsImage *out;
+
+    if (vips_colourspace_issupported(im.get_image()) &&
+        vips_image_guess_interpretation(im.get_image()) !=
+            VIPS_INTERPRETATION_sRGB) {
+        if (vips_colourspace(im.get_image(), &out, VIPS_INTERPRETATION_sRGB,
+                             nullptr))
+            throw Error("unable to convert to sRGB");
+        im = Image(out);
+    }
+
+    if (vips_image_get_format(im.get_image()) != VIPS_FORMAT_UCHAR) {
+        if (vips_cast_uchar(im.get_image(), &out, nullptr))
+            throw Error("unable to cast to uchar");
+        im = Image(out);
+    }
+
+    int bands = im.bands();
+
+    if (bands == 1 || bands == 2) {
+        // grey (plus alpha) ... replicate the grey band
+        VipsImage *grey;
+        if (vips_extract_band(im.get_image(), &grey, 0, nullptr))
+            throw Error("unable to extract band");
+        Image g(grey);
+
+        VipsImage *alpha = nullptr;
+        if (bands == 2 && vips_extract_band(im.get_image(), &alpha, 1, nullptr))
+            throw Error("unable to extract band");
+        Image a(alpha);
+
+        VipsImage *in[] = {grey, grey, grey, alpha};
+        if (vips_bandjoin(in, &out, bands == 2 ? 4 : 3, nullptr))
+            throw Error("unable to join bands");
+        im = Image(out);
+    } else if (bands > 4) {
+        if (vips_extract_band(im.get_image(), &out, 0, "n", 4, nullptr))
+            throw Error("unable to extract bands");
+        im = Image(out);
+    }
+
+    if (im.bands() == 3) {
+        if (vips_bandjoin_const1(im.get_image(), &out, 255.0, nullptr))
+            throw Error("unable to add alpha");
+        im = Image(out);
+    }
+
+    return im;
+}
+
+emscripten::val Image::to_rgba8(emscripten::val dest) const {
+    Image rgba = rgba8();
+    size_t size = VIPS_IMAGE_SIZEOF_IMAGE(rgba.get_image());
+
+    if (!dest.isUndefined()) {
+        if (dest["BYTES_PER_ELEMENT"].as<int>() != 1 ||
+            dest["length"].as<size_t>() < size)
+            throw std::invalid_argument(
+                "destination must be a Uint8ClampedArray or Uint8Array of at "
+                "least width * height * 4 bytes");
+
+        // a view on the Wasm heap, render straight into it
+        emscripten::val heap = emscripten::val(emscripten::typed_memory_view(
+            0, static_cast<uint8_t *>(nullptr)))["buffer"];
+        if (dest["buffer"].strictlyEquals(heap)) {
+            rgba.write_to_memory(dest["byteOffset"].as<uintptr_t>(), size);
+            return dest;
+        }
+    }
+
+    void *mem = vips_image_write_to_memory(rgba.get_image(), &size);
+
+    if (mem == nullptr)
+        throw Error("unable to write to memory");
+
+    emscripten::val view = emscripten::val(
+        emscripten::typed_memory_view(size, static_cast<uint8_t *>(mem)));
+
+    if (dest.isUndefined())
+        dest = emscripten::val::global("Uint8ClampedArray").new_(view);
+    else
+        dest.call<void>("set", view);
+
+    g_free(mem);
+
+    return dest;
+}
+
 #include "vips-operators.cpp"
 
 }  // namespace vips
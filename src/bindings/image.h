@@ -256,18 +256,41 @@ class Image : public Object {
 
     static Image new_memory();
 
+    // Drop the constant images shared by imageize(), see
+    // new_from_constant().
+    static void clear_constant_images();
+
     static Image new_temp_file(const std::string &file_format = "%s.v");
 
     static Image
     new_from_file(const std::string &name,
                   emscripten::val js_options = emscripten::val::null());
 
+    /**
+     * Load a vips-format (`.v`) file, or a raw file when `width`, `height`,
+     * `bands`, `format` and optionally `offset` are given in `js_options`,
+     * by reading the pixels into memory with a single read() rather than
+     * mapping the file in windows. The image owns the memory.
+     */
+    static Image
+    new_from_file_mapped(const std::string &filename,
+                         emscripten::val js_options = emscripten::val::null());
+
     static Image new_from_memory(emscripten::val data, int width, int height,
                                  int bands, emscripten::val format);
 
     static Image new_from_memory(uintptr_t data, size_t size, int width,
                                  int height, int bands, emscripten::val format);
 
+    /**
+     * As new_from_memory(), but the image takes ownership of the memory,
+     * which must have been allocated with malloc(), and frees it when it's
+     * closed. The memory is also freed when the image can't be made.
+     */
+    static Image new_from_memory_owned(uintptr_t data, size_t size, int width,
+                                       int height, int bands,
+                                       VipsBandFormat format);
+
     static Image
     new_from_buffer(const std::string &buffer,
                     const std::string &option_string = "",
@@ -303,6 +326,10 @@ class Image : public Object {
     write_to_file(const std::string &name,
                   emscripten::val js_options = emscripten::val::null()) const;
 
+    VipsBlob *
+    write_to_blob(const std::string &suffix,
+                  emscripten::val js_options = emscripten::val::null()) const;
+
     emscripten::val
     write_to_buffer(const std::string &suffix,
                     emscripten::val js_options = emscripten::val::null()) const;
@@ -313,6 +340,20 @@ class Image : public Object {
 
     emscripten::val write_to_memory() const;
 
+    /**
+     * Render the image to memory allocated by our caller, for example a
+     * buffer on the Wasm heap that is reused between calls.
+     */
+    void write_to_memory(uintptr_t ptr, size_t size) const;
+
+    /**
+     * Render the image as 8-bit sRGB with an alpha channel, ready to draw
+     * on a canvas. The conversion is a single pass through the pipeline.
+     * When `dest` is undefined, a new Uint8ClampedArray is returned,
+     * otherwise the pixels are written to `dest` and it's returned.
+     */
+    emscripten::val to_rgba8(emscripten::val dest) const;
+
 #include "vips-operators.h"
 
     // a few useful things
@@ -370,51 +411,27 @@ class Image : public Object {
         return out;
     }
 
-    Image linear(emscripten::val a, emscripten::val b,
-                 emscripten::val js_options = emscripten::val::null()) const {
-        Image out;
-
-        this->call("linear",
-                   (new Option)
-                       ->set("in", *this)
-                       ->set("out", &out)
-                       ->set("a", VIPS_TYPE_ARRAY_DOUBLE, a)
-                       ->set("b", VIPS_TYPE_ARRAY_DOUBLE, b),
-                   js_options);
-
-        return out;
-    }
-
-    Image linear(emscripten::val a, const std::vector<double> &b) const {
-        Image out;
-
-        this->call("linear", (new Option)
-                                 ->set("in", *this)
-                                 ->set("out", &out)
-                                 ->set("a", VIPS_TYPE_ARRAY_DOUBLE, a)
-                                 ->set("b", b));
-
-        return out;
-    }
-
-    Image linear(const std::vector<double> &a, emscripten::val b) const {
+    // For constants computed on the C++ side, such as the negated or
+    // inverted constants of subtract() and divide().
+    Image linear(const std::vector<double> &a,
+                 const std::vector<double> &b) const {
         Image out;
 
         this->call("linear", (new Option)
                                  ->set("in", *this)
                                  ->set("out", &out)
                                  ->set("a", a)
-                                 ->set("b", VIPS_TYPE_ARRAY_DOUBLE, b));
+                                 ->set("b", b));
 
         return out;
     }
 
     Image linear(const std::vector<double> &a, double b) const {
-        return linear(a, std::vector<double>{b}, emscripten::val::null());
+        return linear(a, std::vector<double>{b});
     }
 
     Image linear(double a, const std::vector<double> &b) const {
-        return linear(std::vector<double>{a}, b, emscripten::val::null());
+        return linear(std::vector<double>{a}, b);
     }
 
     Image add(const Image &right) const {
@@ -585,15 +602,14 @@ class Image : public Object {
         return out;
     }
 
-    Image math2_const(VipsOperationMath2 math2,
-                      const std::vector<double> &c) const {
+    Image math2_const(VipsOperationMath2 math2, emscripten::val c) const {
         Image out;
 
         this->call("math2_const", (new Option)
                                       ->set("in", *this)
                                       ->set("out", &out)
                                       ->set("math2", math2)
-                                      ->set("c", c));
+                                      ->set("c", VIPS_TYPE_ARRAY_DOUBLE, c));
 
         return out;
     }
@@ -611,14 +627,14 @@ class Image : public Object {
     }
 
     Image boolean_const(VipsOperationBoolean boolean,
-                        const std::vector<double> &c) const {
+                        emscripten::val c) const {
         Image out;
 
         this->call("boolean_const", (new Option)
                                         ->set("in", *this)
                                         ->set("out", &out)
                                         ->set("boolean", boolean)
-                                        ->set("c", c));
+                                        ->set("c", VIPS_TYPE_ARRAY_DOUBLE, c));
 
         return out;
     }
@@ -637,19 +653,27 @@ class Image : public Object {
     }
 
     Image relational_const(VipsOperationRelational relational,
-                           const std::vector<double> &c) const {
+                           emscripten::val c) const {
         Image out;
 
-        this->call("relational_const", (new Option)
-                                           ->set("in", *this)
-                                           ->set("out", &out)
-                                           ->set("relational", relational)
-                                           ->set("c", c));
+        this->call("relational_const",
+                   (new Option)
+                       ->set("in", *this)
+                       ->set("out", &out)
+                       ->set("relational", relational)
+                       ->set("c", VIPS_TYPE_ARRAY_DOUBLE, c));
 
         return out;
     }
 
  private:
+    // Like new_from_image(), but the result may be shared with earlier calls,
+    // so it must not be modified.
+    Image new_from_constant(const std::vector<double> &values) const;
+
+    // The pipeline behind to_rgba8().
+    Image rgba8() const;
+
     // sig = vi
     void (*progress_callback)(int percent) = nullptr;
 };
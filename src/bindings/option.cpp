@@ -58,23 +58,21 @@ Option::Pair::Pair(std::string name, const Object &vobject)
     g_value_set_object(&value, object);
 }
 
-// input double array
+// input double array, for values made on the C++ side ... arrays from JS
+// are passed as a val, see below
 Option::Pair::Pair(std::string name, const std::vector<double> &vvector)
     : name(std::move(name)), value(G_VALUE_INIT), type(Type::INPUT) {
     g_value_init(&value, VIPS_TYPE_ARRAY_DOUBLE);
-    vips_value_set_array_double(&value, nullptr,
+    vips_value_set_array_double(&value, vvector.data(),
                                 static_cast<int>(vvector.size()));
-    double *array = vips_value_get_array_double(&value, nullptr);
-    std::copy(vvector.begin(), vvector.end(), array);
 }
 
-// input int array
+// input int array, for values made on the C++ side
 Option::Pair::Pair(std::string name, const std::vector<int> &vvector)
     : name(std::move(name)), value(G_VALUE_INIT), type(Type::INPUT) {
     g_value_init(&value, VIPS_TYPE_ARRAY_INT);
-    vips_value_set_array_int(&value, nullptr, static_cast<int>(vvector.size()));
-    int *array = vips_value_get_array_int(&value, nullptr);
-    std::copy(vvector.begin(), vvector.end(), array);
+    vips_value_set_array_int(&value, vvector.data(),
+                             static_cast<int>(vvector.size()));
 }
 
 // input int array
@@ -101,6 +99,36 @@ Option::Pair::Pair(std::string name, VipsBlob *vblob)
     g_value_set_boxed(&value, vblob);
 }
 
+// input double or int array from JS ... arrays and typed arrays are copied
+// straight into the VipsArea in one go, constants are a one-element array
+Option::Pair::Pair(std::string name, GType gtype, emscripten::val varray)
+    : name(std::move(name)), value(G_VALUE_INIT), type(Type::INPUT) {
+    bool is_array = varray.isArray() || is_typed_array(varray);
+    int n = is_array ? varray["length"].as<int>() : 1;
+
+    g_value_init(&value, gtype);
+
+    if (gtype == VIPS_TYPE_ARRAY_INT) {
+        vips_value_set_array_int(&value, nullptr, n);
+        int *array = vips_value_get_array_int(&value, nullptr);
+
+        if (is_array)
+            emscripten::val(emscripten::typed_memory_view(n, array))
+                .call<void>("set", varray);
+        else
+            array[0] = varray.as<int>();
+    } else {
+        vips_value_set_array_double(&value, nullptr, n);
+        double *array = vips_value_get_array_double(&value, nullptr);
+
+        if (is_array)
+            emscripten::val(emscripten::typed_memory_view(n, array))
+                .call<void>("set", varray);
+        else
+            array[0] = varray.as<double>();
+    }
+}
+
 // output bool
 Option::Pair::Pair(std::string name, bool *vbool)
     : name(std::move(name)), value(G_VALUE_INIT), type(Type::OUTPUT),
@@ -191,10 +219,9 @@ Option *Option::set(const std::string &name, GType type, emscripten::val val,
         set(name, Image::imageize(val, match_image));
     } else if (type == VIPS_TYPE_INTERPOLATE) {
         set(name, val.as<Interpolate>());
-    } else if (type == VIPS_TYPE_ARRAY_INT) {
-        set(name, to_vector<int>(val));
-    } else if (type == VIPS_TYPE_ARRAY_DOUBLE) {
-        set(name, to_vector<double>(val));
+    } else if (type == VIPS_TYPE_ARRAY_INT ||
+               type == VIPS_TYPE_ARRAY_DOUBLE) {
+        options.emplace_back(new Pair(name, type, val));
     } else if (type == VIPS_TYPE_ARRAY_IMAGE) {
         set(name, Image::imageize_vector(val, match_image));
     } else if (type == VIPS_TYPE_BLOB) {
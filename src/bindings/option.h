@@ -72,6 +72,7 @@ class Option {
         Pair(std::string name, const std::vector<int> &vvector);
         Pair(std::string name, const std::vector<Image> &vvector);
         Pair(std::string name, VipsBlob *vblob);
+        Pair(std::string name, GType gtype, emscripten::val varray);
 
         Pair(std::string name, bool *vbool);
         Pair(std::string name, int *vint);
@@ -0,0 +1,93 @@
+#include "region.h"
+#include "error.h"
+#include "utils.h"
+
+#include <stdexcept>
+
+namespace vips {
+
+// copy the valid area of a region to a contiguous typed array
+static emscripten::val region_to_typed_array(VipsRegion *region) {
+    VipsRect *valid = &region->valid;
+    VipsBandFormat format = region->im->BandFmt;
+    size_t line_size = VIPS_IMAGE_SIZEOF_PEL(region->im) * valid->width;
+    size_t lskip = VIPS_REGION_LSKIP(region);
+    VipsPel *p = VIPS_REGION_ADDR(region, valid->left, valid->top);
+
+    // the lines are already contiguous, copy them in one go
+    if (lskip == line_size || valid->height == 1)
+        return to_typed_array(format, p, line_size * valid->height);
+
+    // otherwise copy each line from the heap into place in the result
+    size_t line_length = line_size / vips_format_sizeof(format);
+    emscripten::val out =
+        to_typed_array(format, p, line_size, false)["constructor"].new_(
+            line_length * valid->height);
+
+    for (int y = 0; y < valid->height; ++y, p += lskip)
+        out.call<void>("set", to_typed_array(format, p, line_size, false),
+                       y * line_length);
+
+    return out;
+}
+
+Region Region::new_from_image(const Image &image) {
+    VipsRegion *region = vips_region_new(image.get_image());
+
+    if (region == nullptr)
+        throw Error("unable to make region from image");
+
+    return Region(region);
+}
+
+emscripten::val Region::fetch(int left, int top, int width,
+                              int height) const {
+    VipsRect rect = {left, top, width, height};
+
+    if (vips_region_prepare(get_region(), &rect))
+        throw Error("unable to fetch from region");
+
+    return region_to_typed_array(get_region());
+}
+
+emscripten::val Region::shrink(int left, int top, int width, int height,
+                               int factor, VipsRegionShrink method) const {
+    if (factor < 1 || (factor & (factor - 1)) != 0)
+        throw std::invalid_argument("shrink factor must be a power of two");
+    if (left % factor != 0 || top % factor != 0 || width % factor != 0 ||
+        height % factor != 0)
+        throw std::invalid_argument(
+            "rectangle must be a multiple of the shrink factor");
+
+    VipsRect rect = {left, top, width, height};
+
+    if (vips_region_prepare(get_region(), &rect))
+        throw Error("unable to fetch from region");
+
+    // prepare clips to the image
+    if (!vips_rect_equalsrect(&get_region()->valid, &rect))
+        throw std::invalid_argument("rectangle must lie within the image");
+
+    // shrink 2x2 at a time, the smaller rectangles always fit in the
+    // image, so we can reuse it for the buffers
+    Region from = *this;
+    for (; factor > 1; factor /= 2) {
+        rect.left /= 2;
+        rect.top /= 2;
+        rect.width /= 2;
+        rect.height /= 2;
+
+        Region to(vips_region_new(from.get_region()->im));
+
+        if (vips_region_buffer(to.get_region(), &rect) ||
+            vips_region_shrink_method(from.get_region(), to.get_region(),
+                                      &rect, method))
+            throw Error("unable to shrink region");
+
+        from = to;
+    }
+
+    return region_to_typed_array(from.get_region());
+}
+
+}  // namespace vips
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "image.h"
+#include "object.h"
+
+#include <emscripten/val.h>
+
+#include <vips/vips.h>
+
+namespace vips {
+
+/**
+ * Read rectangles of pixels from an image. Only the requested area is
+ * computed through the pipeline, so this is a cheap way to get a small
+ * part out of a large image.
+ */
+class Region : public Object {
+ public:
+    explicit Region(VipsRegion *region) : Object(VIPS_OBJECT(region)) {}
+
+    // an empty (NULL) Region, eg. "Region a;"
+    Region() : Object(nullptr) {}
+
+    static Region new_from_image(const Image &image);
+
+    VipsRegion *get_region() const {
+        return reinterpret_cast<VipsRegion *>(get_object());
+    }
+
+    /**
+     * Compute a rectangle and copy its pixels out as a typed array
+     * matching the band format of the image.
+     */
+    emscripten::val fetch(int left, int top, int width, int height) const;
+
+    /**
+     * As fetch(), but shrink the rectangle by a power of two on the way,
+     * with a VipsRegionShrink method. The rectangle must lie within the
+     * image and be a multiple of the shrink factor.
+     */
+    emscripten::val
+    shrink(int left, int top, int width, int height, int factor,
+           VipsRegionShrink method = VIPS_REGION_SHRINK_MEAN) const;
+};
+
+}  // namespace vips
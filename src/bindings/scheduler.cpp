@@ -0,0 +1,221 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace vips {
+
+static int pin_gen(VipsRegion *out_region, void *seq, void *a, void *b,
+                   gboolean *stop) {
+    VipsRegion *ir = static_cast<VipsRegion *>(seq);
+    VipsRect *r = &out_region->valid;
+
+    if (vips_region_prepare(ir, r))
+        return -1;
+
+    return vips_region_region(out_region, ir, r, r->left, r->top);
+}
+
+// Wrap an image in a new image that asks for a concurrency of 1. We can't
+// use vips_copy() for this, since that would give us a (shared) result
+// from the operation cache.
+static VipsImage *pin_concurrency(VipsImage *in) {
+    VipsImage *out = vips_image_new();
+
+    // out must keep in alive
+    g_object_ref(in);
+    vips_object_local(out, in);
+
+    if (vips_image_pipelinev(out, VIPS_DEMAND_STYLE_THINSTRIP, in, nullptr) ||
+        vips_image_generate(out, vips_start_one, pin_gen, vips_stop_one, in,
+                            nullptr)) {
+        g_object_unref(out);
+        return nullptr;
+    }
+
+    vips_image_set_int(out, VIPS_META_CONCURRENCY, 1);
+
+    return out;
+}
+
+Scheduler::Scheduler(int threads, double pixel_threshold)
+    : n_threads(threads), threshold(pixel_threshold) {
+    // On the web, each job needs a worker, a libvips worker and a
+    // write-behind thread from the pthread pool, so be conservative.
+    if (n_threads <= 0)
+        n_threads = static_cast<int>(
+            std::max(1u, std::thread::hardware_concurrency() / 4));
+}
+
+void Scheduler::run_job(Job *job, const std::string &suffix,
+                        bool pin_concurrency) {
+    // We must not touch any JS values here, we might be running on a
+    // worker thread.
+    try {
+        if (pin_concurrency) {
+            VipsImage *pinned = vips::pin_concurrency(job->image.get_image());
+            if (pinned == nullptr)
+                throw Error("unable to schedule image");
+
+            job->blob = Image(pinned).write_to_blob(suffix);
+        } else {
+            job->blob = job->image.write_to_blob(suffix);
+        }
+    } catch (const std::exception &e) {
+        job->error = e.what();
+    }
+}
+
+/**
+ * A single write_to_buffers() call. The JS values may only be touched and
+ * released on the main runtime thread.
+ */
+struct Scheduler::Run {
+    Run(emscripten::val resolve, emscripten::val reject)
+        : resolve(std::move(resolve)), reject(std::move(reject)) {}
+
+    std::vector<Job> jobs;
+    std::vector<Job *> small;
+    std::vector<Job *> large;
+    std::string suffix;
+    int n_workers = 0;
+    double utilization = 0.0;
+
+    std::shared_ptr<SchedulerStats> stats;
+
+    emscripten::val resolve;
+    emscripten::val reject;
+};
+
+void Scheduler::write_to_buffers(emscripten::val images,
+                                 const std::string &suffix,
+                                 emscripten::val resolve,
+                                 emscripten::val reject) {
+    if (!images.isArray())
+        throw std::invalid_argument("images must be an array");
+
+    unsigned l = images["length"].as<unsigned>();
+
+    auto job_run = std::make_unique<Run>(resolve, reject);
+    job_run->jobs.resize(l);
+    job_run->suffix = suffix;
+    job_run->stats = last_stats;
+
+    for (unsigned i = 0; i < l; ++i) {
+        emscripten::val v = images[i];
+        if (!is_image(v))
+            throw std::invalid_argument("element " + std::to_string(i) +
+                                        " is not an image");
+
+        Job *job = &job_run->jobs[i];
+        job->image = v.as<Image>();
+
+        double pixels =
+            static_cast<double>(job->image.width()) * job->image.height();
+        if (pixels <= threshold)
+            job_run->small.push_back(job);
+        else
+            job_run->large.push_back(job);
+    }
+
+    job_run->n_workers =
+        std::min(n_threads, static_cast<int>(job_run->small.size()));
+
+    // Starting a thread doesn't wait for it, so this is fine on the main
+    // browser thread. Joining the workers happens on this thread instead.
+    std::thread(run, job_run.get()).detach();
+    job_run.release();
+}
+
+void Scheduler::run(Run *run) {
+    int n_workers = run->n_workers;
+
+    std::atomic<size_t> next(0);
+    std::vector<gint64> busy(n_workers, 0);
+    std::vector<gint64> finished(n_workers, 0);
+    std::vector<std::thread> workers;
+
+    gint64 start = g_get_monotonic_time();
+
+    for (int t = 0; t < n_workers; ++t) {
+        workers.emplace_back([&, t]() {
+            size_t i;
+            while ((i = next++) < run->small.size()) {
+                gint64 job_start = g_get_monotonic_time();
+                run_job(run->small[i], run->suffix, true);
+                busy[t] += g_get_monotonic_time() - job_start;
+            }
+            finished[t] = g_get_monotonic_time();
+        });
+    }
+
+    // Meanwhile, evaluate the large images on this thread, these will use
+    // libvips' own thread pool.
+    for (Job *job : run->large)
+        run_job(job, run->suffix, false);
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    gint64 total_busy = 0;
+    gint64 wall = 0;
+    for (int t = 0; t < n_workers; ++t) {
+        total_busy += busy[t];
+        wall = std::max(wall, finished[t] - start);
+    }
+
+    run->utilization =
+        wall > 0 ? static_cast<double>(total_busy) / (wall * n_workers) : 0.0;
+
+    if (!proxy_async([run]() {
+            finish(run);
+        })) {
+        vips_error("Scheduler", "unable to queue the results");
+
+        // Free what we can. The JS values may only be released on the main
+        // runtime thread, so those are leaked.
+        for (Job &job : run->jobs)
+            if (job.blob != nullptr)
+                vips_area_unref(VIPS_AREA(job.blob));
+        (void) new emscripten::val(std::move(run->resolve));
+        (void) new emscripten::val(std::move(run->reject));
+        delete run;
+    }
+}
+
+void Scheduler::finish(Run *run) {
+    SchedulerStats *stats = run->stats.get();
+    stats->jobs = static_cast<int>(run->jobs.size());
+    stats->inter_image_jobs = static_cast<int>(run->small.size());
+    stats->intra_image_jobs = static_cast<int>(run->large.size());
+    stats->queue_depth = static_cast<int>(run->small.size());
+    stats->threads = run->n_workers;
+    stats->utilization = run->utilization;
+
+    emscripten::val result = emscripten::val::array();
+    std::string error;
+
+    for (size_t i = 0; i < run->jobs.size(); ++i) {
+        VipsBlob *blob = run->jobs[i].blob;
+        if (blob == nullptr) {
+            if (error.empty())
+                error = run->jobs[i].error;
+            continue;
+        }
+
+        result.set(i, BlobVal.new_(emscripten::typed_memory_view(
+                          VIPS_AREA(blob)->length,
+                          static_cast<uint8_t *>(VIPS_AREA(blob)->data))));
+        vips_area_unref(VIPS_AREA(blob));
+    }
+
+    if (error.empty())
+        run->resolve(result);
+    else
+        run->reject(emscripten::val::global("Error").new_(error));
+
+    delete run;
+}
+
+}  // namespace vips
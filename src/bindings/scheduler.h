@@ -0,0 +1,98 @@
+#pragma once
+
+#include "image.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <emscripten/val.h>
+
+namespace vips {
+
+struct SchedulerStats {
+    // number of images handled by the last run
+    int jobs;
+
+    // ... of which were evaluated concurrently, one per thread
+    int inter_image_jobs;
+
+    // ... and of which were evaluated one after the other, each using
+    // libvips' own thread pool
+    int intra_image_jobs;
+
+    // the number of jobs waiting in the queue when the workers started
+    int queue_depth;
+
+    // number of worker threads
+    int threads;
+
+    // fraction of the available worker time spent on evaluation
+    double utilization;
+};
+
+/**
+ * Evaluate a set of independent pipelines.
+ *
+ * libvips parallelizes within a single image, but for small images the
+ * thread pool startup cost dominates. Images with at most
+ * `pixel_threshold` pixels are therefore evaluated concurrently, one per
+ * worker thread, each pinned to a concurrency of 1. Larger images are
+ * evaluated one after the other with libvips' default concurrency.
+ *
+ * All of this happens off the calling thread, so the main browser thread
+ * never blocks. The results are handed back on the main runtime thread.
+ */
+class Scheduler {
+ public:
+    explicit Scheduler(int threads = 0, double pixel_threshold = 1024 * 1024);
+
+    /**
+     * Write a set of images to formatted buffers, without waiting for
+     * them. `resolve` is called with the buffers, in the same order as the
+     * images, or `reject` with an error. Both are called on the main
+     * runtime thread.
+     */
+    void write_to_buffers(emscripten::val images, const std::string &suffix,
+                          emscripten::val resolve, emscripten::val reject);
+
+    int threads() const {
+        return n_threads;
+    }
+
+    double pixel_threshold() const {
+        return threshold;
+    }
+
+    SchedulerStats stats() const {
+        return *last_stats;
+    }
+
+ private:
+    struct Job {
+        Image image;
+
+        // the encoded result, or nullptr on error
+        VipsBlob *blob = nullptr;
+
+        std::string error;
+    };
+
+    struct Run;
+
+    static void run_job(Job *job, const std::string &suffix,
+                        bool pin_concurrency);
+
+    static void run(Run *run);
+
+    static void finish(Run *run);
+
+    int n_threads;
+    double threshold;
+
+    // shared with the runs in flight, which can outlive us
+    std::shared_ptr<SchedulerStats> last_stats =
+        std::make_shared<SchedulerStats>();
+};
+
+}  // namespace vips
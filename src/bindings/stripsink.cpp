@@ -0,0 +1,174 @@
+#include "stripsink.h"
+#include "error.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace vips {
+
+/**
+ * The state shared between the sink thread and the StripSink. The JS
+ * values may only be touched and released on the main runtime thread.
+ */
+struct StripSink::Run {
+    Run(emscripten::val on_strip, emscripten::val on_done)
+        : on_strip(std::move(on_strip)), on_done(std::move(on_done)) {}
+
+    ~Run() {
+        g_free(buffer);
+    }
+
+    Image image;
+    int height = 0;
+    size_t line_size = 0;
+    VipsPel *buffer = nullptr;
+
+    // the strip being gathered, only touched by the sink
+    int top = 0;
+    int lines = 0;
+
+    std::mutex lock;
+    std::condition_variable cond;
+
+    // the lines of the strip that was handed over, 0 once next() is called
+    int handed_over = 0;
+    bool cancelled = false;
+
+    std::string error;
+
+    emscripten::val on_strip;
+    emscripten::val on_done;
+};
+
+StripSink::StripSink(const Image &image, int height, emscripten::val on_strip,
+                     emscripten::val on_done)
+    : sink_run(std::make_shared<Run>(on_strip, on_done)) {
+    VipsImage *in = image.get_image();
+
+    sink_run->image = image;
+    sink_run->height = std::max(1, std::min(height, in->Ysize));
+    sink_run->line_size = VIPS_IMAGE_SIZEOF_LINE(in);
+    sink_run->buffer = static_cast<VipsPel *>(
+        g_malloc(sink_run->line_size * sink_run->height));
+
+    // Starting a thread doesn't wait for it, so this is fine on the main
+    // browser thread.
+    std::thread(run, sink_run).detach();
+}
+
+StripSink::~StripSink() {
+    cancel();
+}
+
+emscripten::val StripSink::data() const {
+    std::lock_guard<std::mutex> lock(sink_run->lock);
+
+    if (sink_run->handed_over == 0)
+        throw std::invalid_argument("no strip to read");
+
+    // complex pixels are handed out as pairs of floats or doubles
+    VipsBandFormat format = sink_run->image.get_image()->BandFmt;
+    if (format == VIPS_FORMAT_COMPLEX)
+        format = VIPS_FORMAT_FLOAT;
+    else if (format == VIPS_FORMAT_DPCOMPLEX)
+        format = VIPS_FORMAT_DOUBLE;
+
+    return to_typed_array(format, sink_run->buffer,
+                          sink_run->line_size * sink_run->handed_over, false);
+}
+
+void StripSink::next() {
+    std::lock_guard<std::mutex> lock(sink_run->lock);
+
+    sink_run->handed_over = 0;
+    sink_run->cond.notify_all();
+}
+
+void StripSink::cancel() {
+    std::lock_guard<std::mutex> lock(sink_run->lock);
+
+    sink_run->cancelled = true;
+    sink_run->cond.notify_all();
+}
+
+int StripSink::hand_over(Run *run) {
+    std::unique_lock<std::mutex> lock(run->lock);
+
+    if (run->cancelled)
+        return -1;
+
+    run->handed_over = run->lines;
+
+    // The finish below is queued after this, so run outlives the call.
+    int top = run->top;
+    int height = run->lines;
+    if (!proxy_async([run, top, height]() {
+            run->on_strip(top, height);
+        })) {
+        // Nobody would ever call next(), so don't wait for it.
+        run->handed_over = 0;
+        run->cancelled = true;
+        run->error = "unable to hand over a strip";
+        return -1;
+    }
+
+    run->cond.wait(lock, [run]() {
+        return run->handed_over == 0 || run->cancelled;
+    });
+
+    if (run->cancelled)
+        return -1;
+
+    run->top += run->lines;
+    run->lines = 0;
+
+    return 0;
+}
+
+// Called by vips_sink_disc() with the scanlines in order, on a background
+// thread.
+int StripSink::write(VipsRegion *region, VipsRect *area, void *a) {
+    Run *run = static_cast<Run *>(a);
+    int image_height = region->im->Ysize;
+
+    for (int y = area->top; y < VIPS_RECT_BOTTOM(area); ++y) {
+        memcpy(run->buffer + run->lines * run->line_size,
+               VIPS_REGION_ADDR(region, area->left, y), run->line_size);
+
+        if ((++run->lines == run->height || y + 1 == image_height) &&
+            hand_over(run))
+            return -1;
+    }
+
+    return 0;
+}
+
+void StripSink::run(std::shared_ptr<Run> run) {
+    // We must not touch any JS values here.
+    if (vips_sink_disc(run->image.get_image(), write, run.get())) {
+        std::lock_guard<std::mutex> lock(run->lock);
+
+        if (run->cancelled)
+            vips_error_clear();
+        else
+            run->error = Error("unable to write strips").what();
+    }
+
+    // Hand our reference to the main thread, so that the JS values are
+    // released there. It's kept on the heap, since a call that can't be
+    // queued is destroyed on this thread.
+    auto *done = new std::shared_ptr<Run>(std::move(run));
+    if (!proxy_async([done]() {
+            std::unique_ptr<std::shared_ptr<Run>> own(done);
+            (*done)->on_done((*done)->error);
+        })) {
+        // We can't release the JS values on this thread, so we leak
+        // them rather than corrupt the handle table.
+        vips_error("StripSink", "unable to queue the end of the strips");
+    }
+}
+
+}  // namespace vips
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "image.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <emscripten/val.h>
+
+#include <vips/vips.h>
+
+namespace vips {
+
+/**
+ * Evaluate an image once, top to bottom, and hand it over a strip of
+ * scanlines at a time.
+ *
+ * The image is written with vips_sink_disc() on a thread of its own, so
+ * the main browser thread never blocks. The scanlines are gathered into a
+ * single buffer on the Wasm heap and `on_strip(top, height)` is called on
+ * the main runtime thread for each full strip (the last one can be
+ * shorter). The sink then waits for next() before it reuses the buffer.
+ * `on_done(error)` is called once at the end, with an empty string if all
+ * went well.
+ */
+class StripSink {
+ public:
+    StripSink(const Image &image, int height, emscripten::val on_strip,
+              emscripten::val on_done);
+
+    // stops the sink if it's still running
+    ~StripSink();
+
+    /**
+     * A typed array view on the pixels of the current strip, only valid
+     * until next() is called.
+     */
+    emscripten::val data() const;
+
+    /**
+     * Let the sink go on with the next strip.
+     */
+    void next();
+
+    /**
+     * Stop the sink early, `on_done` is still called.
+     */
+    void cancel();
+
+ private:
+    struct Run;
+
+    static void run(std::shared_ptr<Run> run);
+
+    static int write(VipsRegion *region, VipsRect *area, void *a);
+
+    static int hand_over(Run *run);
+
+    std::shared_ptr<Run> sink_run;
+};
+
+}  // namespace vips
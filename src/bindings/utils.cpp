@@ -2,11 +2,37 @@
 
 #include "option.h"
 
+#include <stdexcept>
+
+#include <emscripten/em_js.h>
 #include <emscripten/proxying.h>
 #include <emscripten/threading.h>
 
 namespace vips {
 
+// clang-format off
+EM_JS(int, js_width_2D, (emscripten::EM_VAL handle), {
+    const value = Emval.toValue(handle);
+    if (!Array.isArray(value) || value.length === 0 ||
+        !Array.isArray(value[0])) {
+        return -1;
+    }
+
+    const width = value[0].length;
+    for (let i = 1; i < value.length; i++) {
+        if (!Array.isArray(value[i]) || value[i].length !== width) {
+            return -1;
+        }
+    }
+
+    return width;
+});
+// clang-format on
+
+int width_2D(emscripten::val value) {
+    return js_width_2D(value.as_handle());
+}
+
 std::vector<int> blend_modes_to_int(emscripten::val v) {
     std::vector<int> int_modes;
 
@@ -24,6 +50,39 @@ std::vector<int> blend_modes_to_int(emscripten::val v) {
     return int_modes;
 }
 
+template <typename T>
+static emscripten::val typed_array(const char *name, const void *data,
+                                   size_t size, bool copy) {
+    emscripten::val view(emscripten::typed_memory_view(
+        size / sizeof(T), static_cast<const T *>(data)));
+
+    return copy ? emscripten::val::global(name).new_(view) : view;
+}
+
+emscripten::val to_typed_array(VipsBandFormat format, const void *data,
+                               size_t size, bool copy) {
+    switch (format) {
+        case VIPS_FORMAT_UCHAR:
+            return typed_array<uint8_t>("Uint8Array", data, size, copy);
+        case VIPS_FORMAT_CHAR:
+            return typed_array<int8_t>("Int8Array", data, size, copy);
+        case VIPS_FORMAT_USHORT:
+            return typed_array<uint16_t>("Uint16Array", data, size, copy);
+        case VIPS_FORMAT_SHORT:
+            return typed_array<int16_t>("Int16Array", data, size, copy);
+        case VIPS_FORMAT_UINT:
+            return typed_array<uint32_t>("Uint32Array", data, size, copy);
+        case VIPS_FORMAT_INT:
+            return typed_array<int32_t>("Int32Array", data, size, copy);
+        case VIPS_FORMAT_FLOAT:
+            return typed_array<float>("Float32Array", data, size, copy);
+        case VIPS_FORMAT_DOUBLE:
+            return typed_array<double>("Float64Array", data, size, copy);
+        default:
+            throw std::invalid_argument("band format unsupported");
+    }
+}
+
 std::vector<double> negate(const std::vector<double> &vector) {
     std::vector<double> new_vector(vector.size());
 
@@ -53,4 +112,22 @@ bool proxy_sync(const std::function<void()> &func) {
                                  (void *)&func);
 }
 
+static void run_once(void *arg) {
+    std::function<void()> *f = static_cast<std::function<void()> *>(arg);
+    (*f)();
+    delete f;
+}
+
+bool proxy_async(std::function<void()> func) {
+    em_proxying_queue *q = emscripten_proxy_get_system_queue();
+    std::function<void()> *f = new std::function<void()>(std::move(func));
+    if (!emscripten_proxy_async(q, emscripten_main_runtime_thread_id(),
+                                run_once, f)) {
+        delete f;
+        return false;
+    }
+
+    return true;
+}
+
 }  // namespace vips
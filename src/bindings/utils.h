@@ -6,6 +6,8 @@
 
 #include <emscripten/val.h>
 
+#include <vips/vips.h>
+
 namespace vips {
 
 /**
@@ -15,6 +17,8 @@ static const emscripten::val ObjectKeysVal =
     emscripten::val::global("Object")["keys"];
 static const emscripten::val BlobVal =
     emscripten::val::global("Uint8Array");
+static const emscripten::val ArrayBufferIsViewVal =
+    emscripten::val::global("ArrayBuffer")["isView"];
 
 /**
  * Determines if a JS value is of the specified type.
@@ -28,27 +32,21 @@ inline bool is_image(emscripten::val value) {
     return is_type(value["isImage"], "function");
 }
 
+inline bool is_typed_array(emscripten::val value) {
+    return ArrayBufferIsViewVal(value).as<bool>();
+}
+
+/**
+ * The width of a rectangular array of arrays, or -1 if the JS value is
+ * something else. All rows are checked with a single call into JS.
+ */
+int width_2D(emscripten::val value);
+
 /**
  * Determines if a JS value is a rectangular array of something.
  */
 inline bool is_2D(emscripten::val value) {
-    if (!value.isArray())
-        return false;
-
-    unsigned l = value["length"].as<unsigned>();
-    if (l == 0 || !value[0].isArray())
-        return false;
-
-    unsigned l_first = value[0]["length"].as<unsigned>();
-
-    for (unsigned i = 1; i < l; ++i) {
-        if (!value[i].isArray() ||
-            value[i]["length"].as<unsigned>() != l_first) {
-            return false;
-        }
-    }
-
-    return true;
+    return width_2D(value) >= 0;
 }
 
 /**
@@ -57,9 +55,32 @@ inline bool is_2D(emscripten::val value) {
 template <typename T, typename = typename std::enable_if<
                           std::is_arithmetic<T>::value>::type>
 std::vector<T> to_vector(emscripten::val v) {
+    // Arrays and typed arrays are copied in bulk, through a typed array view
+    // on the vector.
+    if (v.isArray() || is_typed_array(v))
+        return emscripten::convertJSArrayToNumberVector<T>(v);
+
     // Allow single pixels/images (for e.g. `vips.image.newFromImage(127.5)`)
-    return v.isArray() ? emscripten::vecFromJSArray<T>(v)
-                       : std::vector<T>{v.as<T>()};
+    return std::vector<T>{v.as<T>()};
+}
+
+/**
+ * Copies pixel data to a new typed array matching the band format, or
+ * makes a view on the Wasm heap when `copy` is false.
+ */
+emscripten::val to_typed_array(VipsBandFormat format, const void *data,
+                               size_t size, bool copy = true);
+
+/**
+ * Adds a JS function to the Wasm table, with `p` in the signature for
+ * pointer-sized arguments and results. The table index is a JS number for
+ * both wasm32 and wasm64, so we don't let Embind convert it to `uintptr_t`.
+ */
+template <typename F>
+F add_function(emscripten::val js_func, const char *sig) {
+    emscripten::val index = emscripten::val::module_property("addFunction")(
+        js_func, emscripten::val(sig));
+    return reinterpret_cast<F>(static_cast<uintptr_t>(index.as<double>()));
 }
 
 /*
@@ -78,4 +99,10 @@ std::vector<double> invert(const std::vector<double> &vector);
  */
 bool proxy_sync(const std::function<void()> &func);
 
+/**
+ * Queue a JS call on the main runtime thread, without waiting for it. This
+ * also runs the next time the main thread waits on a lock or a proxied call.
+ */
+bool proxy_async(std::function<void()> func);
+
 }  // namespace vips
@@ -1356,7 +1356,7 @@ Image Image::addalpha() const
     return out;
 }
 
-Image Image::affine(const std::vector<double> &matrix, emscripten::val js_options) const
+Image Image::affine(emscripten::val matrix, emscripten::val js_options) const
 {
     Image out;
 
@@ -1364,7 +1364,7 @@ Image Image::affine(const std::vector<double> &matrix, emscripten::val js_option
                (new Option)
                    ->set("in", *this)
                    ->set("out", &out)
-                   ->set("matrix", matrix),
+                   ->set("matrix", VIPS_TYPE_ARRAY_DOUBLE, matrix),
                js_options);
 
     return out;
@@ -1446,7 +1446,7 @@ Image Image::bandunfold(emscripten::val js_options) const
     return out;
 }
 
-Image Image::boolean_const(emscripten::val boolean, const std::vector<double> &c) const
+Image Image::boolean_const(emscripten::val boolean, emscripten::val c) const
 {
     Image out;
 
@@ -1455,7 +1455,7 @@ Image Image::boolean_const(emscripten::val boolean, const std::vector<double> &c
                    ->set("in", *this)
                    ->set("out", &out)
                    ->set("boolean", VIPS_TYPE_OPERATION_BOOLEAN, boolean)
-                   ->set("c", c));
+                   ->set("c", VIPS_TYPE_ARRAY_DOUBLE, c));
 
     return out;
 }
@@ -1826,24 +1826,24 @@ double Image::deviate() const
     return out;
 }
 
-void Image::draw_circle(const std::vector<double> &ink, int cx, int cy, int radius, emscripten::val js_options) const
+void Image::draw_circle(emscripten::val ink, int cx, int cy, int radius, emscripten::val js_options) const
 {
     this->call("draw_circle",
                (new Option)
                    ->set("image", *this)
-                   ->set("ink", ink)
+                   ->set("ink", VIPS_TYPE_ARRAY_DOUBLE, ink)
                    ->set("cx", cx)
                    ->set("cy", cy)
                    ->set("radius", radius),
                js_options);
 }
 
-void Image::draw_flood(const std::vector<double> &ink, int x, int y, emscripten::val js_options) const
+void Image::draw_flood(emscripten::val ink, int x, int y, emscripten::val js_options) const
 {
     this->call("draw_flood",
                (new Option)
                    ->set("image", *this)
-                   ->set("ink", ink)
+                   ->set("ink", VIPS_TYPE_ARRAY_DOUBLE, ink)
                    ->set("x", x)
                    ->set("y", y),
                js_options);
@@ -1860,35 +1860,35 @@ void Image::draw_image(emscripten::val sub, int x, int y, emscripten::val js_opt
                js_options);
 }
 
-void Image::draw_line(const std::vector<double> &ink, int x1, int y1, int x2, int y2) const
+void Image::draw_line(emscripten::val ink, int x1, int y1, int x2, int y2) const
 {
     this->call("draw_line",
                (new Option)
                    ->set("image", *this)
-                   ->set("ink", ink)
+                   ->set("ink", VIPS_TYPE_ARRAY_DOUBLE, ink)
                    ->set("x1", x1)
                    ->set("y1", y1)
                    ->set("x2", x2)
                    ->set("y2", y2));
 }
 
-void Image::draw_mask(const std::vector<double> &ink, emscripten::val mask, int x, int y) const
+void Image::draw_mask(emscripten::val ink, emscripten::val mask, int x, int y) const
 {
     this->call("draw_mask",
                (new Option)
                    ->set("image", *this)
-                   ->set("ink", ink)
+                   ->set("ink", VIPS_TYPE_ARRAY_DOUBLE, ink)
                    ->set("mask", VIPS_TYPE_IMAGE, mask, this)
                    ->set("x", x)
                    ->set("y", y));
 }
 
-void Image::draw_rect(const std::vector<double> &ink, int left, int top, int width, int height, emscripten::val js_options) const
+void Image::draw_rect(emscripten::val ink, int left, int top, int width, int height, emscripten::val js_options) const
 {
     this->call("draw_rect",
                (new Option)
                    ->set("image", *this)
-                   ->set("ink", ink)
+                   ->set("ink", VIPS_TYPE_ARRAY_DOUBLE, ink)
                    ->set("left", left)
                    ->set("top", top)
                    ->set("width", width)
@@ -2573,7 +2573,7 @@ Image Image::labelregions(emscripten::val js_options) const
     return mask;
 }
 
-Image Image::linear(const std::vector<double> &a, const std::vector<double> &b, emscripten::val js_options) const
+Image Image::linear(emscripten::val a, emscripten::val b, emscripten::val js_options) const
 {
     Image out;
 
@@ -2581,8 +2581,8 @@ Image Image::linear(const std::vector<double> &a, const std::vector<double> &b,
                (new Option)
                    ->set("in", *this)
                    ->set("out", &out)
-                   ->set("a", a)
-                   ->set("b", b),
+                   ->set("a", VIPS_TYPE_ARRAY_DOUBLE, a)
+                   ->set("b", VIPS_TYPE_ARRAY_DOUBLE, b),
                js_options);
 
     return out;
@@ -2664,7 +2664,7 @@ Image Image::math(emscripten::val math) const
     return out;
 }
 
-Image Image::math2_const(emscripten::val math2, const std::vector<double> &c) const
+Image Image::math2_const(emscripten::val math2, emscripten::val c) const
 {
     Image out;
 
@@ -2673,7 +2673,7 @@ Image Image::math2_const(emscripten::val math2, const std::vector<double> &c) co
                    ->set("in", *this)
                    ->set("out", &out)
                    ->set("math2", VIPS_TYPE_OPERATION_MATH2, math2)
-                   ->set("c", c));
+                   ->set("c", VIPS_TYPE_ARRAY_DOUBLE, c));
 
     return out;
 }
@@ -3182,7 +3182,7 @@ Image Image::reducev(double vshrink, emscripten::val js_options) const
     return out;
 }
 
-Image Image::relational_const(emscripten::val relational, const std::vector<double> &c) const
+Image Image::relational_const(emscripten::val relational, emscripten::val c) const
 {
     Image out;
 
@@ -3191,12 +3191,12 @@ Image Image::relational_const(emscripten::val relational, const std::vector<doub
                    ->set("in", *this)
                    ->set("out", &out)
                    ->set("relational", VIPS_TYPE_OPERATION_RELATIONAL, relational)
-                   ->set("c", c));
+                   ->set("c", VIPS_TYPE_ARRAY_DOUBLE, c));
 
     return out;
 }
 
-Image Image::remainder_const(const std::vector<double> &c) const
+Image Image::remainder_const(emscripten::val c) const
 {
     Image out;
 
@@ -3204,7 +3204,7 @@ Image Image::remainder_const(const std::vector<double> &c) const
                (new Option)
                    ->set("in", *this)
                    ->set("out", &out)
-                   ->set("c", c));
+                   ->set("c", VIPS_TYPE_ARRAY_DOUBLE, c));
 
     return out;
 }
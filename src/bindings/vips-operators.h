@@ -812,7 +812,7 @@ Image addalpha() const;
  * @param js_options Optional options.
  * @return Output image.
  */
-Image affine(const std::vector<double> &matrix, emscripten::val js_options = emscripten::val::null()) const;
+Image affine(emscripten::val matrix, emscripten::val js_options = emscripten::val::null()) const;
 
 /**
  * Autorotate image by exif tag.
@@ -860,7 +860,7 @@ Image bandunfold(emscripten::val js_options = emscripten::val::null()) const;
  * @param c Array of constants.
  * @return Output image.
  */
-Image boolean_const(emscripten::val boolean, const std::vector<double> &c) const;
+Image boolean_const(emscripten::val boolean, emscripten::val c) const;
 
 /**
  * Build a look-up table.
@@ -1076,7 +1076,7 @@ double deviate() const;
  * @param radius Radius in pixels.
  * @param js_options Optional options.
  */
-void draw_circle(const std::vector<double> &ink, int cx, int cy, int radius, emscripten::val js_options = emscripten::val::null()) const;
+void draw_circle(emscripten::val ink, int cx, int cy, int radius, emscripten::val js_options = emscripten::val::null()) const;
 
 /**
  * Flood-fill an area.
@@ -1085,7 +1085,7 @@ void draw_circle(const std::vector<double> &ink, int cx, int cy, int radius, ems
  * @param y DrawFlood start point.
  * @param js_options Optional options.
  */
-void draw_flood(const std::vector<double> &ink, int x, int y, emscripten::val js_options = emscripten::val::null()) const;
+void draw_flood(emscripten::val ink, int x, int y, emscripten::val js_options = emscripten::val::null()) const;
 
 /**
  * Paint an image into another image.
@@ -1104,7 +1104,7 @@ void draw_image(emscripten::val sub, int x, int y, emscripten::val js_options =
  * @param x2 End of draw_line.
  * @param y2 End of draw_line.
  */
-void draw_line(const std::vector<double> &ink, int x1, int y1, int x2, int y2) const;
+void draw_line(emscripten::val ink, int x1, int y1, int x2, int y2) const;
 
 /**
  * Draw a mask on an image.
@@ -1113,7 +1113,7 @@ void draw_line(const std::vector<double> &ink, int x1, int y1, int x2, int y2) c
  * @param x Draw mask here.
  * @param y Draw mask here.
  */
-void draw_mask(const std::vector<double> &ink, emscripten::val mask, int x, int y) const;
+void draw_mask(emscripten::val ink, emscripten::val mask, int x, int y) const;
 
 /**
  * Paint a rectangle on an image.
@@ -1124,7 +1124,7 @@ void draw_mask(const std::vector<double> &ink, emscripten::val mask, int x, int
  * @param height Rect to fill.
  * @param js_options Optional options.
  */
-void draw_rect(const std::vector<double> &ink, int left, int top, int width, int height, emscripten::val js_options = emscripten::val::null()) const;
+void draw_rect(emscripten::val ink, int left, int top, int width, int height, emscripten::val js_options = emscripten::val::null()) const;
 
 /**
  * Blur a rectangle on an image.
@@ -1518,7 +1518,7 @@ Image labelregions(emscripten::val js_options = emscripten::val::null()) const;
  * @param js_options Optional options.
  * @return Output image.
  */
-Image linear(const std::vector<double> &a, const std::vector<double> &b, emscripten::val js_options = emscripten::val::null()) const;
+Image linear(emscripten::val a, emscripten::val b, emscripten::val js_options = emscripten::val::null()) const;
 
 /**
  * Cache an image as a set of lines.
@@ -1572,7 +1572,7 @@ Image math(emscripten::val math) const;
  * @param c Array of constants.
  * @return Output image.
  */
-Image math2_const(emscripten::val math2, const std::vector<double> &c) const;
+Image math2_const(emscripten::val math2, emscripten::val c) const;
 
 /**
  * Invert a matrix.
@@ -1879,14 +1879,14 @@ Image reducev(double vshrink, emscripten::val js_options = emscripten::val::null
  * @param c Array of constants.
  * @return Output image.
  */
-Image relational_const(emscripten::val relational, const std::vector<double> &c) const;
+Image relational_const(emscripten::val relational, emscripten::val c) const;
 
 /**
  * Remainder after integer division of an image and a constant.
  * @param c Array of constants.
  * @return Output image.
  */
-Image remainder_const(const std::vector<double> &c) const;
+Image remainder_const(emscripten::val c) const;
 
 /**
  * Rebuild an mosaiced image.
@@ -1,7 +1,12 @@
+#include "bindings/cache.h"
 #include "bindings/connection.h"
+#include "bindings/framepool.h"
 #include "bindings/image.h"
 #include "bindings/interpolate.h"
 #include "bindings/object.h"
+#include "bindings/region.h"
+#include "bindings/scheduler.h"
+#include "bindings/stripsink.h"
 #include "bindings/utils.h"
 
 #include <emscripten/bind.h>
@@ -9,33 +14,115 @@
 #include <emscripten/val.h>
 #include <emscripten/version.h>
 #ifdef WASMFS
+#include <emscripten/heap.h>
 #include <emscripten/wasmfs.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
 #endif
 
 #include <vips/vips.h>
 
 using namespace emscripten;
 
+using vips::AdaptiveCache;
 using vips::Connection;
+using vips::DecodeCache;
+using vips::DecodeCacheStats;
+using vips::FramePool;
 using vips::Image;
 using vips::Interpolate;
 using vips::Object;
+using vips::OperationCache;
 using vips::Option;
+using vips::RangeStats;
+using vips::ReadAheadStats;
+using vips::Region;
+using vips::ResultCache;
+using vips::ResultCacheStats;
+using vips::Scheduler;
+using vips::SchedulerStats;
 using vips::Source;
 using vips::SourceCustom;
+using vips::SourceRanges;
+using vips::StripSink;
 using vips::Target;
 using vips::TargetCustom;
 
 #ifdef WASMFS
 EM_JS(bool, is_node, (), { return ENVIRONMENT_IS_NODE; });
 
+EM_JS(bool, use_opfs_tmp, (), { return VIPS.opfsTmp; });
+
+EM_JS(void, opfs_tmp_failed, (), {
+    VIPS.opfsTmp = Module['opfsTmp'] = false;
+});
+
 backend_t wasmfs_create_root_dir() {
     return is_node() ? wasmfs_create_node_backend("")
                      : wasmfs_create_memory_backend();
 }
+
+// Our temp files live in a subdirectory of their own, so that we never touch
+// other files in the origin private file system (OPFS) of the origin.
+static const char *opfs_dir = "/opfs";
+static const char *opfs_tmp_dir = "/opfs/wasm-vips-tmp";
+
+// Remove the temp files a previous session left behind, for example when the
+// page was closed before libvips could unlink them. Files still in use by
+// another instance are locked by their sync access handle, those fail to
+// unlink and are left alone.
+static void empty_dir(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir == nullptr)
+        return;
+
+    while (struct dirent *entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") == 0 ||
+            strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        char *name = g_build_filename(path, entry->d_name, nullptr);
+        unlink(name);
+        g_free(name);
+    }
+
+    closedir(dir);
+}
+
+// Point TMPDIR at the OPFS, so that temp files spill to real storage. /tmp
+// itself stays in memory.
+static void mount_opfs_tmp() {
+    if (!use_opfs_tmp())
+        return;
+
+    if (wasmfs_create_directory(opfs_dir, 0777,
+                                wasmfs_create_opfs_backend()) != 0 ||
+        (mkdir(opfs_tmp_dir, 0777) != 0 && errno != EEXIST)) {
+        g_warning("unable to use OPFS for temp files, using memory instead");
+
+        // keep large images in memory, see the preRun in vips-library.js
+        std::string threshold = std::to_string(emscripten_get_heap_max());
+        setenv("VIPS_DISC_THRESHOLD", threshold.c_str(), 1);
+        opfs_tmp_failed();
+        return;
+    }
+
+    empty_dir(opfs_tmp_dir);
+    setenv("TMPDIR", opfs_tmp_dir, 1);
+}
 #endif
 
 int main() {
+#ifdef WASMFS
+    mount_opfs_tmp();
+#endif
+
     if (vips_init("wasm-vips"))
         vips_error_exit("unable to start up libvips");
 
@@ -43,8 +130,10 @@ int main() {
     //  - cache 100 operations;
     //  - spend 100 MiB of memory;
     //  - hold 100 files open;
-    // We need to lower these numbers for Wasm a bit.
-    vips_cache_set_max_mem(50 * 1024 * 1024);  // = 50 MiB
+    // We need to lower these numbers for Wasm a bit. The number of
+    // operations and the memory are sized against the Wasm heap, see
+    // AdaptiveCache.
+    AdaptiveCache::init();
     vips_cache_set_max_files(20);
 
     // Handy for debugging.
@@ -410,6 +499,43 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .field("columns", &ColumnsRowsResult::columns)
         .field("rows", &ColumnsRowsResult::rows);
 
+    value_object<ResultCacheStats>("resultCacheStats")
+        .field("entries", &ResultCacheStats::entries)
+        .field("mem", &ResultCacheStats::mem)
+        .field("hits", &ResultCacheStats::hits)
+        .field("misses", &ResultCacheStats::misses)
+        .field("evictions", &ResultCacheStats::evictions);
+
+    value_object<DecodeCacheStats>("decodeCacheStats")
+        .field("entries", &DecodeCacheStats::entries)
+        .field("size", &DecodeCacheStats::size)
+        .field("hits", &DecodeCacheStats::hits)
+        .field("misses", &DecodeCacheStats::misses)
+        .field("evictions", &DecodeCacheStats::evictions);
+
+    value_object<ReadAheadStats>("readAheadStats")
+        .field("fetches", &ReadAheadStats::fetches)
+        .field("bytesFetched", &ReadAheadStats::bytes_fetched)
+        .field("stalls", &ReadAheadStats::stalls)
+        .field("stallTime", &ReadAheadStats::stall_time);
+
+    value_object<RangeStats>("rangeStats")
+        .field("blocks", &RangeStats::blocks)
+        .field("mem", &RangeStats::mem)
+        .field("hits", &RangeStats::hits)
+        .field("misses", &RangeStats::misses)
+        .field("fetches", &RangeStats::fetches)
+        .field("bytesFetched", &RangeStats::bytes_fetched)
+        .field("hitRatio", &RangeStats::hit_ratio);
+
+    value_object<SchedulerStats>("schedulerStats")
+        .field("jobs", &SchedulerStats::jobs)
+        .field("interImageJobs", &SchedulerStats::inter_image_jobs)
+        .field("intraImageJobs", &SchedulerStats::intra_image_jobs)
+        .field("queueDepth", &SchedulerStats::queue_depth)
+        .field("threads", &SchedulerStats::threads)
+        .field("utilization", &SchedulerStats::utilization);
+
     // Register non-arithmetic vector bindings
     register_vector<Image>("VectorImage");
     register_vector<std::string>("VectorString");
@@ -446,19 +572,50 @@ EMSCRIPTEN_BINDINGS(my_module) {
                  vips_operation_block_set(name.c_str(), state ? 1 : 0);
              }));
 
-    // Helper to shutdown libvips
-    function("shutdown", &vips_shutdown);
+    // Helper to shutdown libvips, drops the images we keep around first
+    function("shutdown", optional_override([]() {
+                 Image::clear_constant_images();
+                 ResultCache::clear();
+                 vips_shutdown();
+             }));
 
     // Cache class
     class_<Cache>("Cache")
         .constructor<>()
-        .class_function("max", &vips_cache_set_max)
+        .class_function("max", optional_override([](int max) {
+                            // explicit limits disable the adaptive policy
+                            AdaptiveCache::set_enabled(false);
+                            vips_cache_set_max(max);
+                        }))
         .class_function("max", &vips_cache_get_max)
-        .class_function("maxMem", &vips_cache_set_max_mem)
+        .class_function("maxMem", optional_override([](size_t max_mem) {
+                            AdaptiveCache::set_enabled(false);
+                            vips_cache_set_max_mem(max_mem);
+                        }))
         .class_function("maxMem", &vips_cache_get_max_mem)
+        .class_function("adaptive", &AdaptiveCache::set_enabled)
+        .class_function("adaptive", &AdaptiveCache::enabled)
+        .class_function("memoryCeiling", &AdaptiveCache::ceiling)
         .class_function("maxFiles", &vips_cache_set_max_files)
         .class_function("maxFiles", &vips_cache_get_max_files)
-        .class_function("size", &vips_cache_get_size);
+        .class_function("size", &vips_cache_get_size)
+        .class_function("stats", &OperationCache::stats)
+        .class_function("drop", &OperationCache::drop)
+        .class_function("drop", optional_override([]() {
+                            return OperationCache::drop(val::undefined());
+                        }))
+        .class_function("trimTrackedMem", &OperationCache::trim_tracked_mem)
+        .class_function("resultMaxMem", &ResultCache::set_max_mem)
+        .class_function("resultMaxMem", &ResultCache::get_max_mem)
+        .class_function("resultStore", &ResultCache::set_store)
+        .class_function("resultStats", &ResultCache::stats)
+        .class_function("resultClear", &ResultCache::clear)
+        .class_function("decodeDir", &DecodeCache::set_dir)
+        .class_function("decodeDir", &DecodeCache::get_dir)
+        .class_function("decodeMaxSize", &DecodeCache::set_max_size)
+        .class_function("decodeMaxSize", &DecodeCache::get_max_size)
+        .class_function("decodeStats", &DecodeCache::stats)
+        .class_function("decodeClear", &DecodeCache::clear);
 
     // Stats class
     class_<Stats>("Stats")
@@ -488,6 +645,39 @@ EMSCRIPTEN_BINDINGS(my_module) {
                             return result;
                         }));
 
+    // Scheduler class
+    class_<Scheduler>("Scheduler")
+        .constructor<>()
+        .constructor<int>()
+        .constructor<int, double>()
+        .property("threads", &Scheduler::threads)
+        .property("pixelThreshold", &Scheduler::pixel_threshold)
+        .function("writeToBuffers", &Scheduler::write_to_buffers)
+        .function("stats", &Scheduler::stats);
+
+    // FramePool class
+    class_<FramePool>("FramePool")
+        .constructor<>()
+        .constructor<int, int, int, emscripten::val, int>()
+        .property("width", &FramePool::width)
+        .property("height", &FramePool::height)
+        .property("bands", &FramePool::bands)
+        .property("count", &FramePool::count)
+        .property("size", &FramePool::size)
+        .property("available", &FramePool::available)
+        .function("acquire", &FramePool::acquire)
+        .function("release", &FramePool::release)
+        .function("view", &FramePool::view)
+        .function("image", &FramePool::image)
+        .function("write", &FramePool::write);
+
+    // StripSink class, used by Image.strips()
+    class_<StripSink>("StripSink")
+        .constructor<const Image &, int, emscripten::val, emscripten::val>()
+        .function("data", &StripSink::data)
+        .function("next", &StripSink::next)
+        .function("cancel", &StripSink::cancel);
+
     // Base class
     class_<Object>("Object");
 
@@ -497,6 +687,28 @@ EMSCRIPTEN_BINDINGS(my_module) {
         // Handwritten class functions
         .class_function("newFromName", &Interpolate::new_from_name);
 
+    // Region class
+    class_<Region, base<Object>>("Region")
+        .constructor<>()
+        // Handwritten class functions
+        .class_function("newFromImage", &Region::new_from_image)
+        // Handwritten functions
+        .function("fetch", &Region::fetch)
+        .function("shrink",
+                  optional_override([](const Region &region, int left, int top,
+                                       int width, int height, int factor,
+                                       emscripten::val method) {
+                      return region.shrink(
+                          left, top, width, height, factor,
+                          static_cast<VipsRegionShrink>(Option::to_enum(
+                              VIPS_TYPE_REGION_SHRINK, method)));
+                  }))
+        .function("shrink",
+                  optional_override([](const Region &region, int left, int top,
+                                       int width, int height, int factor) {
+                      return region.shrink(left, top, width, height, factor);
+                  }));
+
     // Connection class
     class_<Connection, base<Object>>("Connection")
         .constructor<>()
@@ -509,7 +721,13 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .constructor<>()
         // Handwritten class functions
         .class_function("newFromFile", &Source::new_from_file)
-        .class_function("newFromMemory", &Source::new_from_memory);
+        .class_function("newFromMemory", &Source::new_from_memory)
+        .class_function("newFromRanges", &SourceRanges::new_from_ranges)
+        .class_function("newFromRanges",
+                        optional_override([](val fetch_range, double size) {
+                            return SourceRanges::new_from_ranges(
+                                fetch_range, size, val::null());
+                        }));
 
     // SourceCustom class
     class_<SourceCustom, base<Source>>("SourceCustom")
@@ -518,7 +736,17 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .property("onRead", &SourceCustom::stub_getter,
                   &SourceCustom::set_read_callback)
         .property("onSeek", &SourceCustom::stub_getter,
-                  &SourceCustom::set_seek_callback);
+                  &SourceCustom::set_seek_callback)
+        .property("readAhead", &SourceCustom::get_read_ahead,
+                  &SourceCustom::set_read_ahead)
+        // Handwritten functions
+        .function("stats", &SourceCustom::stats);
+
+    // SourceRanges class
+    class_<SourceRanges, base<Source>>("SourceRanges")
+        .constructor<>()
+        // Handwritten functions
+        .function("stats", &SourceRanges::stats);
 
     // Target class
     class_<Target, base<Connection>>("Target")
@@ -556,6 +784,11 @@ EMSCRIPTEN_BINDINGS(my_module) {
                         optional_override([](const std::string &name) {
                             return Image::new_from_file(name);
                         }))
+        .class_function("newFromFileMapped", &Image::new_from_file_mapped)
+        .class_function("newFromFileMapped",
+                        optional_override([](const std::string &filename) {
+                            return Image::new_from_file_mapped(filename);
+                        }))
         .class_function(
             "newFromMemory",
             select_overload<Image(emscripten::val, int, int, int,
@@ -564,6 +797,16 @@ EMSCRIPTEN_BINDINGS(my_module) {
             "newFromMemory",
             select_overload<Image(uintptr_t, size_t, int, int, int,
                                   emscripten::val)>(&Image::new_from_memory))
+        .class_function(
+            "newFromMemoryOwned",
+            optional_override([](uintptr_t data, size_t size, int width,
+                                 int height, int bands,
+                                 emscripten::val format) {
+                return Image::new_from_memory_owned(
+                    data, size, width, height, bands,
+                    static_cast<VipsBandFormat>(
+                        Option::to_enum(VIPS_TYPE_BAND_FORMAT, format)));
+            }))
         .class_function("newFromBuffer", &Image::new_from_buffer)
         .class_function("newFromBuffer",
                         optional_override([](const std::string &buffer,
@@ -699,7 +942,16 @@ EMSCRIPTEN_BINDINGS(my_module) {
                                        const std::string &suffix) {
                       return image.write_to_target(target, suffix);
                   }))
-        .function("writeToMemory", &Image::write_to_memory)
+        .function("writeToMemory",
+                  select_overload<emscripten::val() const>(
+                      &Image::write_to_memory))
+        .function("writeToMemory",
+                  select_overload<void(uintptr_t, size_t) const>(
+                      &Image::write_to_memory))
+        .function("toRGBA8", &Image::to_rgba8)
+        .function("toRGBA8", optional_override([](const Image &image) {
+                      return image.to_rgba8(emscripten::val::undefined());
+                  }))
         .function("findTrim", optional_override([](const Image &image,
                                                    emscripten::val js_options) {
                       int left, top, width, height;
@@ -955,28 +1207,25 @@ EMSCRIPTEN_BINDINGS(my_module) {
             "pow", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.math2(b.as<Image>(), VIPS_OPERATION_MATH2_POW)
-                           : a.math2_const(VIPS_OPERATION_MATH2_POW,
-                                           vips::to_vector<double>(b));
+                           : a.math2_const(VIPS_OPERATION_MATH2_POW, b);
             }))
         .function(
             "wop", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.math2(b.as<Image>(), VIPS_OPERATION_MATH2_WOP)
-                           : a.math2_const(VIPS_OPERATION_MATH2_WOP,
-                                           vips::to_vector<double>(b));
+                           : a.math2_const(VIPS_OPERATION_MATH2_WOP, b);
             }))
         .function(
             "atan2", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.math2(b.as<Image>(), VIPS_OPERATION_MATH2_ATAN2)
-                           : a.math2_const(VIPS_OPERATION_MATH2_ATAN2,
-                                           vips::to_vector<double>(b));
+                           : a.math2_const(VIPS_OPERATION_MATH2_ATAN2, b);
             }))
         .function("add",
                   optional_override([](const Image &a, emscripten::val b) {
                       return vips::is_image(b)
                                  ? a.add(b.as<Image>())
-                                 : a.linear(1.0, vips::to_vector<double>(b));
+                                 : a.linear(emscripten::val(1.0), b);
                   }))
         .function(
             "subtract",
@@ -990,7 +1239,7 @@ EMSCRIPTEN_BINDINGS(my_module) {
                   optional_override([](const Image &a, emscripten::val b) {
                       return vips::is_image(b)
                                  ? a.multiply(b.as<Image>())
-                                 : a.linear(vips::to_vector<double>(b), 0.0);
+                                 : a.linear(b, emscripten::val(0.0));
                   }))
         .function(
             "divide", optional_override([](const Image &a, emscripten::val b) {
@@ -1003,56 +1252,53 @@ EMSCRIPTEN_BINDINGS(my_module) {
                   optional_override([](const Image &a, emscripten::val b) {
                       return vips::is_image(b)
                                  ? a.remainder(b.as<Image>())
-                                 : a.remainder_const(
-                                       vips::to_vector<double>(b));
+                                 : a.remainder_const(b);
                   }))
         .function(
             "lshift", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.boolean(b.as<Image>(),
                                        VIPS_OPERATION_BOOLEAN_LSHIFT)
-                           : a.boolean_const(VIPS_OPERATION_BOOLEAN_LSHIFT,
-                                             vips::to_vector<double>(b));
+                           : a.boolean_const(VIPS_OPERATION_BOOLEAN_LSHIFT, b);
             }))
         .function(
             "rshift", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.boolean(b.as<Image>(),
                                        VIPS_OPERATION_BOOLEAN_RSHIFT)
-                           : a.boolean_const(VIPS_OPERATION_BOOLEAN_RSHIFT,
-                                             vips::to_vector<double>(b));
+                           : a.boolean_const(VIPS_OPERATION_BOOLEAN_RSHIFT, b);
             }))
         .function("and",
                   optional_override([](const Image &a, emscripten::val b) {
                       return vips::is_image(b)
                                  ? a.boolean(b.as<Image>(),
                                              VIPS_OPERATION_BOOLEAN_AND)
-                                 : a.boolean_const(VIPS_OPERATION_BOOLEAN_AND,
-                                                   vips::to_vector<double>(b));
+                                 : a.boolean_const(
+                                       VIPS_OPERATION_BOOLEAN_AND, b);
                   }))
         .function("or",
                   optional_override([](const Image &a, emscripten::val b) {
                       return vips::is_image(b)
                                  ? a.boolean(b.as<Image>(),
                                              VIPS_OPERATION_BOOLEAN_OR)
-                                 : a.boolean_const(VIPS_OPERATION_BOOLEAN_OR,
-                                                   vips::to_vector<double>(b));
+                                 : a.boolean_const(
+                                       VIPS_OPERATION_BOOLEAN_OR, b);
                   }))
         .function("eor",
                   optional_override([](const Image &a, emscripten::val b) {
                       return vips::is_image(b)
                                  ? a.boolean(b.as<Image>(),
                                              VIPS_OPERATION_BOOLEAN_EOR)
-                                 : a.boolean_const(VIPS_OPERATION_BOOLEAN_EOR,
-                                                   vips::to_vector<double>(b));
+                                 : a.boolean_const(
+                                       VIPS_OPERATION_BOOLEAN_EOR, b);
                   }))
         .function(
             "more", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.relational(b.as<Image>(),
                                           VIPS_OPERATION_RELATIONAL_MORE)
-                           : a.relational_const(VIPS_OPERATION_RELATIONAL_MORE,
-                                                vips::to_vector<double>(b));
+                           : a.relational_const(
+                                 VIPS_OPERATION_RELATIONAL_MORE, b);
             }))
         .function(
             "moreEq", optional_override([](const Image &a, emscripten::val b) {
@@ -1060,16 +1306,15 @@ EMSCRIPTEN_BINDINGS(my_module) {
                            ? a.relational(b.as<Image>(),
                                           VIPS_OPERATION_RELATIONAL_MOREEQ)
                            : a.relational_const(
-                                 VIPS_OPERATION_RELATIONAL_MOREEQ,
-                                 vips::to_vector<double>(b));
+                                 VIPS_OPERATION_RELATIONAL_MOREEQ, b);
             }))
         .function(
             "less", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.relational(b.as<Image>(),
                                           VIPS_OPERATION_RELATIONAL_LESS)
-                           : a.relational_const(VIPS_OPERATION_RELATIONAL_LESS,
-                                                vips::to_vector<double>(b));
+                           : a.relational_const(
+                                 VIPS_OPERATION_RELATIONAL_LESS, b);
             }))
         .function(
             "lessEq", optional_override([](const Image &a, emscripten::val b) {
@@ -1077,24 +1322,23 @@ EMSCRIPTEN_BINDINGS(my_module) {
                            ? a.relational(b.as<Image>(),
                                           VIPS_OPERATION_RELATIONAL_LESSEQ)
                            : a.relational_const(
-                                 VIPS_OPERATION_RELATIONAL_LESSEQ,
-                                 vips::to_vector<double>(b));
+                                 VIPS_OPERATION_RELATIONAL_LESSEQ, b);
             }))
         .function(
             "equal", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.relational(b.as<Image>(),
                                           VIPS_OPERATION_RELATIONAL_EQUAL)
-                           : a.relational_const(VIPS_OPERATION_RELATIONAL_EQUAL,
-                                                vips::to_vector<double>(b));
+                           : a.relational_const(
+                                 VIPS_OPERATION_RELATIONAL_EQUAL, b);
             }))
         .function(
             "notEq", optional_override([](const Image &a, emscripten::val b) {
                 return vips::is_image(b)
                            ? a.relational(b.as<Image>(),
                                           VIPS_OPERATION_RELATIONAL_NOTEQ)
-                           : a.relational_const(VIPS_OPERATION_RELATIONAL_NOTEQ,
-                                                vips::to_vector<double>(b));
+                           : a.relational_const(
+                                 VIPS_OPERATION_RELATIONAL_NOTEQ, b);
             }))
         // Auto-generated properties
         .property("width", &Image::width)
@@ -1433,7 +1677,7 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .function("abs", &Image::abs)
         .function("addalpha", &Image::addalpha)
         .function("affine", &Image::affine)
-        .function("affine", optional_override([](const Image &image, const std::vector<double> &matrix) {
+        .function("affine", optional_override([](const Image &image, emscripten::val matrix) {
                       return image.affine(matrix);
                   }))
         .function("autorot", &Image::autorot)
@@ -1516,11 +1760,11 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .function("dECMC", &Image::dECMC)
         .function("deviate", &Image::deviate)
         .function("drawCircle", &Image::draw_circle)
-        .function("drawCircle", optional_override([](const Image &image, const std::vector<double> &ink, int cx, int cy, int radius) {
+        .function("drawCircle", optional_override([](const Image &image, emscripten::val ink, int cx, int cy, int radius) {
                       image.draw_circle(ink, cx, cy, radius);
                   }))
         .function("drawFlood", &Image::draw_flood)
-        .function("drawFlood", optional_override([](const Image &image, const std::vector<double> &ink, int x, int y) {
+        .function("drawFlood", optional_override([](const Image &image, emscripten::val ink, int x, int y) {
                       image.draw_flood(ink, x, y);
                   }))
         .function("drawImage", &Image::draw_image)
@@ -1530,7 +1774,7 @@ EMSCRIPTEN_BINDINGS(my_module) {
         .function("drawLine", &Image::draw_line)
         .function("drawMask", &Image::draw_mask)
         .function("drawRect", &Image::draw_rect)
-        .function("drawRect", optional_override([](const Image &image, const std::vector<double> &ink, int left, int top, int width, int height) {
+        .function("drawRect", optional_override([](const Image &image, emscripten::val ink, int left, int top, int width, int height) {
                       image.draw_rect(ink, left, top, width, height);
                   }))
         .function("drawSmudge", &Image::draw_smudge)
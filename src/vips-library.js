@@ -6,17 +6,31 @@ var LibraryVips = {
     '$deletionQueue',
     '$addOnPreRun',
     '$addOnPostCtor',
+    'malloc',
+    'free',
   ],
   $VIPS__postset: 'VIPS.init();',
   $VIPS: {
+    autoDeleteLater: false,
+    opfsTmp: false,
     init() {
       addOnPreRun(() => {
 #if ENVIRONMENT_MAY_BE_WEB
-        // On the web, raise VIPS_DISC_THRESHOLD (default: 100 MiB of uncompressed pixel data) to ensure large images
+#if WASMFS
+        // In a worker, WasmFS can keep temp files in the origin private file system (OPFS), which is backed by real
+        // storage, see `main()`. Sync access handles are not available on the main browser thread. Pass
+        // `opfsTmp: false` to keep them in memory instead.
+        VIPS.opfsTmp = Module['opfsTmp'] !== false && typeof WorkerGlobalScope != 'undefined' &&
+          !!globalThis.navigator?.storage?.getDirectory;
+#endif
+
+        // Otherwise, raise VIPS_DISC_THRESHOLD (default: 100 MiB of uncompressed pixel data) to ensure large images
         // are processed in-memory. This avoids spilling to temporary `/tmp` files via MEMFS (JS-based filesystem or
         // WasmFS), which would otherwise incur costly Wasm <-> JS crossings or internal filesystem abstractions
         // (virtual calls, bounds checks and buffer resizing).
-        ENV['VIPS_DISC_THRESHOLD'] = {{{ MAXIMUM_MEMORY }}};
+        if (!VIPS.opfsTmp) {
+          ENV['VIPS_DISC_THRESHOLD'] = {{{ MAXIMUM_MEMORY }}};
+        }
 
         // Enforce a fixed thread pool by default on the web.
         ENV['VIPS_MAX_THREADS'] = {{{ PTHREAD_POOL_SIZE }}};
@@ -30,24 +44,206 @@ var LibraryVips = {
         // libvips stores temporary files by default in `/tmp`; set the TMPDIR env variable to override this directory.
         ENV['TMPDIR'] = require('node:os').tmpdir();
 #endif
+
+        Module['opfsTmp'] = VIPS.opfsTmp;
+
+        // Keep track of the auto delete state for scope(), this runs before the preRun callbacks of the user
+        const setAutoDeleteLater = Module['setAutoDeleteLater'];
+        Module['setAutoDeleteLater'] = (enable) => {
+          VIPS.autoDeleteLater = enable;
+          setAutoDeleteLater(enable);
+        };
       });
 
+      // Delete every handle made by `fn` once it returns, except for its result, the elements or own properties of
+      // its result and the handles kept with preventAutoDelete()
+      Module['scope'] = (fn) => {
+        const autoDeleteLater = VIPS.autoDeleteLater;
+        if (!autoDeleteLater) {
+          Module['setAutoDeleteLater'](true);
+        }
+
+        const start = deletionQueue.length;
+        let result;
+        try {
+          const value = fn();
+          if (typeof value?.then === 'function') {
+            throw new TypeError('scope() needs a synchronous function, the handles would be deleted before it settles');
+          }
+          result = value;
+        } finally {
+          if (!autoDeleteLater) {
+            Module['setAutoDeleteLater'](false);
+          }
+
+          const kept = new Set([result]);
+          if (result !== null && typeof result === 'object' && !ArrayBuffer.isView(result)) {
+            for (const value of Object.values(result)) {
+              kept.add(value);
+            }
+          }
+
+          for (const handle of deletionQueue.splice(start)) {
+            if (kept.has(handle)) {
+              if (autoDeleteLater) {
+                deletionQueue.push(handle);
+              } else {
+                handle.$$.deleteScheduled = false;
+              }
+            } else if (!handle['isDeleted']()) {
+              handle.$$.deleteScheduled = false;
+              handle['delete']();
+            }
+          }
+        }
+
+        return result;
+      };
+
+      // Whether this is the wasm64 flavour, see `--enable-memory64`
+      Module['memory64'] = {{{ !!MEMORY64 }}};
+
       addOnPostCtor(() => {
+        // Emval handles are pointer-sized, i.e. a BigInt in a wasm64 function table entry
+#if MEMORY64
+        const toHandle = (value) => BigInt(Emval.toHandle(value));
+        const toValue = (handle) => Emval.toValue(Number(handle));
+#else
+        const toHandle = Emval.toHandle;
+        const toValue = Emval.toValue;
+#endif
+
+        // Scheduler.writeToBuffers evaluates off the calling thread and settles on the main thread
+        const writeToBuffers = Module['Scheduler'].prototype['writeToBuffers'];
+        Module['Scheduler'].prototype['writeToBuffers'] = function (images, suffix) {
+          return new Promise((resolve, reject) => writeToBuffers.call(this, images, suffix, resolve, reject));
+        };
+
         // SourceCustom.onRead marshaller
         const sourceCustom = Object.getOwnPropertyDescriptor(Module['SourceCustom'].prototype, 'onRead');
         Object.defineProperty(Module['SourceCustom'].prototype, 'onRead', {
           set(cb) {
-            return sourceCustom.set.call(this, length => Emval.toHandle(cb(length)));
+            return sourceCustom.set.call(this, length => toHandle(cb(length)));
           }
         });
 
+        // Source.newFromRanges marshaller
+        const newFromRanges = Module['Source']['newFromRanges'];
+        Module['Source']['newFromRanges'] = function (fetchRange, ...args) {
+          return newFromRanges((offset, length) => toHandle(fetchRange(offset, length)), ...args);
+        };
+
+        // TargetCustom.onRead marshaller
+        const targetCustomRead = Object.getOwnPropertyDescriptor(Module['TargetCustom'].prototype, 'onRead');
+        Object.defineProperty(Module['TargetCustom'].prototype, 'onRead', {
+          set(cb) {
+            return targetCustomRead.set.call(this, length => toHandle(cb(length)));
+          }
+        });
+
+        // SourceCustom.onSeek and TargetCustom.onSeek marshallers, positions are doubles in Wasm and may be
+        // returned as BigInt
+        for (const connection of ['SourceCustom', 'TargetCustom']) {
+          const onSeek = Object.getOwnPropertyDescriptor(Module[connection].prototype, 'onSeek');
+          Object.defineProperty(Module[connection].prototype, 'onSeek', {
+            set(cb) {
+              return onSeek.set.call(this, (offset, whence) => Number(cb(offset, whence)));
+            }
+          });
+        }
+
         // TargetCustom.onWrite marshaller
         const targetCustom = Object.getOwnPropertyDescriptor(Module['TargetCustom'].prototype, 'onWrite');
         Object.defineProperty(Module['TargetCustom'].prototype, 'onWrite', {
           set(cb) {
-            return targetCustom.set.call(this, data => cb(Emval.toValue(data)));
+            return targetCustom.set.call(this, data => cb(toValue(data)));
           }
         });
+
+        // Image.newFromImageData, the pixels are copied once
+        Module['Image']['newFromImageData'] = function (imageData) {
+          return Module['Image']['newFromMemory'](imageData.data, imageData.width, imageData.height, 4, 'uchar');
+        };
+
+#if ENVIRONMENT_MAY_BE_WEB
+        // Image.newFromVideoFrame, copies the frame straight into memory that the image takes ownership of
+        Module['Image']['newFromVideoFrame'] = async function (frame) {
+          const options = { 'format': 'RGBA', 'colorSpace': 'srgb' };
+          const width = frame['visibleRect']['width'];
+          const height = frame['visibleRect']['height'];
+          const size = frame['allocationSize'](options);
+          const ptr = _malloc(size);
+          if (!ptr) {
+            throw new Error('unable to allocate frame');
+          }
+
+          try {
+            await frame['copyTo'](HEAPU8.subarray(ptr, ptr + size), options);
+          } catch (e) {
+            _free(ptr);
+            throw e;
+          }
+
+          return Module['Image']['newFromMemoryOwned'](ptr, size, width, height, 4, 'uchar');
+        };
+
+        // Image.newFromImageBitmap, through a VideoFrame on the bitmap, which doesn't copy the pixels
+        Module['Image']['newFromImageBitmap'] = async function (bitmap) {
+          const frame = new VideoFrame(bitmap, { 'timestamp': 0 });
+          try {
+            return await Module['Image']['newFromVideoFrame'](frame);
+          } finally {
+            frame['close']();
+          }
+        };
+#endif
+
+        // Image.toImageData, for drawing onto a canvas
+        Module['Image'].prototype['toImageData'] = function () {
+          return new ImageData(this['toRGBA8'](), this['width'], this['height']);
+        };
+
+        // Image.strips async iterator, evaluates the image once and hands it over a strip at a time
+        Module['Image'].prototype['strips'] = async function* (height = 128) {
+          const events = [];
+          let wake = null;
+          const push = (event) => {
+            events.push(event);
+            if (wake) {
+              wake();
+              wake = null;
+            }
+          };
+
+          const sink = new Module['StripSink'](this, height,
+            (top, stripHeight) => push({ top, height: stripHeight }),
+            (error) => push({ error }))['preventAutoDelete']();
+          try {
+            while (true) {
+              if (events.length === 0) {
+                await new Promise(resolve => wake = resolve);
+              }
+
+              const event = events.shift();
+              if ('error' in event) {
+                if (event.error) {
+                  throw new Error(event.error);
+                }
+                return;
+              }
+
+              yield {
+                'top': event.top,
+                'height': event.height,
+                'data': sink['data']()
+              };
+              sink['next']();
+            }
+          } finally {
+            // stops the sink if we're left early
+            sink['delete']();
+          }
+        };
       });
 
       // Add preventAutoDelete method to ClassHandle
@@ -0,0 +1,86 @@
+// Measure the overhead of the bindings on tiny images, as seen from JS.
+// This is the counterpart of src/bench/binding-bench.cpp, which measures
+// the same cases without the JS <-> Wasm crossings, see README.md.
+import { performance } from 'node:perf_hooks';
+
+import Vips from '../../lib/vips-node.mjs';
+
+let flush = () => {};
+const vips = await Vips({
+  // Disable dynamic modules
+  dynamicLibraries: [],
+  preRun: (module) => {
+    module.setAutoDeleteLater(true);
+    module.setDelayFunction((fn) => {
+      flush = fn;
+    });
+  }
+});
+
+// We want to measure building operations, not cache lookups
+vips.Cache.max(0);
+
+const bench = (name, fn) => {
+  // warm up
+  for (let i = 0; i < 100; i++) {
+    fn();
+  }
+  flush();
+
+  // double the iterations until we run for at least half a second
+  let iterations = 100;
+  let elapsed;
+  let handles;
+  for (;;) {
+    handles = 0;
+    const start = performance.now();
+    for (let i = 0; i < iterations; i++) {
+      fn();
+      handles += vips.deletionQueue.length;
+      flush();
+    }
+    elapsed = performance.now() - start;
+
+    if (elapsed >= 500) {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  const ns = elapsed * 1e6 / iterations;
+  console.log(`${name.padEnd(36)} ${ns.toFixed(0).padStart(12)} ns/call ` +
+    `${(handles / iterations).toFixed(2).padStart(10)} handles/call`);
+};
+
+const tiny = vips.Image.black(8, 8).copyMemory();
+tiny.preventAutoDelete();
+const tinyRgb = vips.Image.black(8, 8, { bands: 3 }).copyMemory();
+tinyRgb.preventAutoDelete();
+
+// Tiny-image op chains
+bench('call: invert', () => tiny.invert());
+bench('chain: invert.flip.avg', () => tiny.invert().flip('horizontal').avg());
+
+// kwargs-heavy calls
+bench('kwargs: embed {extend, background}', () => tinyRgb.embed(1, 1, 10, 10, {
+  extend: 'background',
+  background: [1, 2, 3]
+}));
+bench('kwargs: affine {5 options}', () => tiny.affine([1, 0, 0, 1], {
+  odx: 0.5,
+  ody: 0.5,
+  idx: 0.5,
+  idy: 0.5,
+  extend: 'copy'
+}));
+
+// Constant to image promotion
+bench('imageize: bandjoin(255)', () => tiny.bandjoin(255));
+bench('imageize: bandjoin([255, 255, 255])', () => tinyRgb.bandjoin([255, 255, 255]));
+bench('ifthenelse: constants', () => tiny.ifthenelse([255, 255, 255], 0.5));
+
+tiny.delete();
+tinyRgb.delete();
+
+// We are done, shutdown libvips
+vips.shutdown();
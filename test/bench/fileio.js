@@ -0,0 +1,86 @@
+// Measure file I/O throughput of newFromFile -> writeToFile on ~100 MB
+// TIFFs, see README.md. Pass `--module <path>` to compare builds, for
+// example the default NODERAWFS build against a WasmFS build. The buffer
+// cases read and write the same files in one go on the JS side, which is
+// the baseline for the file system.
+import { mkdtempSync, readFileSync, rmSync, statSync, writeFileSync } from 'node:fs';
+import os from 'node:os';
+import path from 'node:path';
+import { performance } from 'node:perf_hooks';
+
+const args = process.argv.slice(2);
+const moduleIndex = args.indexOf('--module');
+const vipsModule = moduleIndex === -1
+  ? '../../lib/vips-node.mjs'
+  : path.resolve(args[moduleIndex + 1]);
+
+const { default: Vips } = await import(vipsModule);
+
+let flush = () => {};
+const vips = await Vips({
+  // Disable dynamic modules
+  dynamicLibraries: [],
+  preRun: (module) => {
+    module.setAutoDeleteLater(true);
+    module.setDelayFunction((fn) => {
+      flush = fn;
+    });
+  }
+});
+
+// We want to measure the I/O, not cache lookups
+vips.Cache.max(0);
+
+const dir = mkdtempSync(path.join(os.tmpdir(), 'wasm-vips-fileio-'));
+const input = path.join(dir, 'input.tif');
+
+// 6000 x 6000 x 3 bytes is ~103 MiB of pixels
+vips.Image.gaussnoise(6000, 6000)
+  .cast('uchar')
+  .bandjoin([127, 255])
+  .tiffsave(input);
+flush();
+const inputBytes = statSync(input).size;
+
+const bench = (name, output, options, buffers = false) => {
+  const run = () => {
+    if (buffers) {
+      const im = vips.Image.newFromBuffer(readFileSync(input), '', { access: 'sequential' });
+      writeFileSync(output, im.writeToBuffer(path.extname(output), options));
+    } else {
+      vips.Image.newFromFile(input, { access: 'sequential' })
+        .writeToFile(output, options);
+    }
+    flush();
+  };
+
+  // warm up, this also fills the page cache
+  run();
+
+  const runs = 5;
+  const start = performance.now();
+  for (let i = 0; i < runs; i++) {
+    run();
+  }
+  const elapsed = (performance.now() - start) / runs;
+
+  const outputBytes = statSync(output).size;
+  const mbPerSec = (inputBytes + outputBytes) / (1024 * 1024) / (elapsed / 1000);
+  console.log(`${name.padEnd(36)} ${elapsed.toFixed(0).padStart(8)} ms ` +
+    `${mbPerSec.toFixed(1).padStart(10)} MB/s`);
+};
+
+console.log(`module: ${vipsModule}`);
+console.log(`input: ${(inputBytes / (1024 * 1024)).toFixed(1)} MiB TIFF`);
+
+bench('tiff -> tiff', path.join(dir, 'output.tif'));
+bench('tiff -> tiff (tiled)', path.join(dir, 'tiled.tif'), { tile: true });
+bench('tiff -> v', path.join(dir, 'output.v'));
+bench('tiff -> jpeg', path.join(dir, 'output.jpg'));
+bench('tiff -> tiff (buffers)', path.join(dir, 'output.tif'), {}, true);
+bench('tiff -> jpeg (buffers)', path.join(dir, 'output.jpg'), {}, true);
+
+rmSync(dir, { recursive: true, force: true });
+
+// We are done, shutdown libvips
+vips.shutdown();
@@ -0,0 +1,61 @@
+// Measure the cost of making matrix images from JS arrays, see README.md.
+import { performance } from 'node:perf_hooks';
+
+import Vips from '../../lib/vips-node.mjs';
+
+let flush = () => {};
+const vips = await Vips({
+  // Disable dynamic modules
+  dynamicLibraries: [],
+  preRun: (module) => {
+    module.setAutoDeleteLater(true);
+    module.setDelayFunction((fn) => {
+      flush = fn;
+    });
+  }
+});
+
+const bench = (name, fn) => {
+  // warm up
+  for (let i = 0; i < 100; i++) {
+    fn();
+  }
+  flush();
+
+  // double the iterations until we run for at least half a second
+  let iterations = 100;
+  let elapsed;
+  for (;;) {
+    const start = performance.now();
+    for (let i = 0; i < iterations; i++) {
+      fn();
+      flush();
+    }
+    elapsed = performance.now() - start;
+
+    if (elapsed >= 500) {
+      break;
+    }
+    iterations *= 2;
+  }
+
+  const us = elapsed * 1e3 / iterations;
+  console.log(`${name.padEnd(36)} ${us.toFixed(2).padStart(12)} µs/call`);
+};
+
+const nested = (width, height) => Array.from({ length: height }, (_, y) =>
+  Array.from({ length: width }, (_, x) => x + y * width));
+
+for (const [width, height] of [[3, 3], [64, 64], [1024, 1]]) {
+  const size = `${width}x${height}`;
+  const array = nested(width, height);
+  const flat = array.flat();
+  const typed = Float64Array.from(flat);
+
+  bench(`newFromArray: ${size} nested`, () => vips.Image.newFromArray(array));
+  bench(`newMatrix: ${size} array`, () => vips.Image.newMatrix(width, height, flat));
+  bench(`newMatrix: ${size} Float64Array`, () => vips.Image.newMatrix(width, height, typed));
+}
+
+// We are done, shutdown libvips
+vips.shutdown();
@@ -15,8 +15,8 @@ const pngOut = getPath('output.png');
 const webpOut = getPath('output.webp');
 
 const vips = await Vips({
-  // Disable dynamic modules
-  dynamicLibraries: []
+  // Only load the HEIF module, for the AVIF suite
+  dynamicLibraries: ['vips-heif.wasm']
 });
 
 // Disable libvips cache to ensure tests are as fair as they can be
@@ -42,6 +42,14 @@ const defaultWebPSaveOptions = {
   Q: 80
 };
 
+const avifOut = getPath('output.avif');
+const defaultAvifSaveOptions = {
+  keep: vips.ForeignKeep.none,
+  compression: vips.ForeignHeifCompression.av1,
+  Q: 50
+};
+const haveAvif = vips.Utils.typeFind('VipsOperation', 'heifsave') !== 0;
+
 const runSuites = (suites) => {
   if (suites.length === 0) {
     // We are done, shutdown libvips
@@ -400,8 +408,61 @@ const webpSuite = new Benchmark.Suite('webp').add('wasm-vips-buffer-file', {
     im.delete();
     deferred.resolve();
   }
+}).add('wasm-vips-full-size-encode', {
+  // Encode a larger image without resizing, this is where
+  // `./build.sh --enable-webp-threads` should make a difference
+  defer: true,
+  fn: (deferred) => {
+    const im = vips.Image.newFromBuffer(inputJpgBuffer);
+    im.webpsaveBuffer(defaultWebPSaveOptions);
+    im.delete();
+    deferred.resolve();
+  }
+}).add('wasm-vips-full-size-decode', {
+  defer: true,
+  fn: (deferred) => {
+    const im = vips.Image.newFromBuffer(inputWebPBuffer);
+    im.avg();
+    im.delete();
+    deferred.resolve();
+  }
 }).on('cycle', (event) => {
   console.log(`webp ${String(event.target)}`);
 });
 
-runSuites([jpegSuite, operationsSuite, pngSuite, webpSuite]);
+// AVIF
+const avifSuite = new Benchmark.Suite('avif').add('wasm-vips-buffer-file', {
+  defer: true,
+  fn: (deferred) => {
+    const im = vips.Image.thumbnailBuffer(inputJpgBuffer, width, {
+      height
+    });
+    im.heifsave(avifOut, defaultAvifSaveOptions);
+    im.delete();
+    deferred.resolve();
+  }
+}).add('wasm-vips-buffer-buffer', {
+  defer: true,
+  fn: (deferred) => {
+    const im = vips.Image.thumbnailBuffer(inputJpgBuffer, width, {
+      height
+    });
+    im.heifsaveBuffer(defaultAvifSaveOptions);
+    im.delete();
+    deferred.resolve();
+  }
+}).add('wasm-vips-full-size-encode', {
+  // Encode a larger image without resizing, this is where
+  // `./build.sh --enable-avif-threads` should make a difference
+  defer: true,
+  fn: (deferred) => {
+    const im = vips.Image.newFromBuffer(inputJpgBuffer);
+    im.heifsaveBuffer(defaultAvifSaveOptions);
+    im.delete();
+    deferred.resolve();
+  }
+}).on('cycle', (event) => {
+  console.log(`avif ${String(event.target)}`);
+});
+
+runSuites([jpegSuite, operationsSuite, pngSuite, webpSuite, ...(haveAvif ? [avifSuite] : [])]);
@@ -0,0 +1,355 @@
+// Regression benchmark suite, see README.md.
+import Benchmark from 'benchmark';
+
+import { spawnSync } from 'node:child_process';
+import { existsSync, readFileSync, writeFileSync } from 'node:fs';
+import os from 'node:os';
+import { performance } from 'node:perf_hooks';
+import { fileURLToPath } from 'node:url';
+
+import { inputJpg, inputPng } from './images.js';
+
+const vipsModule = '../../lib/vips-node.mjs';
+const operatorsModule = './operators.js';
+
+function parseArgs (argv) {
+  const args = {
+    json: null,
+    filter: null,
+    concurrency: 1,
+    startupRuns: 5,
+    compare: null,
+    threshold: 5,
+    startupChild: false
+  };
+
+  for (let i = 0; i < argv.length; i++) {
+    switch (argv[i]) {
+      case '--json':
+        args.json = argv[++i];
+        break;
+      case '--filter':
+        args.filter = new RegExp(argv[++i]);
+        break;
+      case '--concurrency':
+        args.concurrency = Number(argv[++i]);
+        break;
+      case '--startup-runs':
+        args.startupRuns = Number(argv[++i]);
+        break;
+      case '--compare':
+        args.compare = [argv[++i], argv[++i]];
+        break;
+      case '--threshold':
+        args.threshold = Number(argv[++i]);
+        break;
+      case '--startup-child':
+        args.startupChild = true;
+        break;
+      default:
+        console.error(`Unknown argument: ${argv[i]}`);
+        process.exit(2);
+    }
+  }
+
+  return args;
+}
+
+async function loadVips () {
+  const { default: Vips } = await import(vipsModule);
+
+  let flush = () => {};
+  const vips = await Vips({
+    // Disable dynamic modules
+    dynamicLibraries: [],
+    preRun: (module) => {
+      module.setAutoDeleteLater(true);
+      module.setDelayFunction((fn) => {
+        flush = fn;
+      });
+      module.ENV.VIPS_WARNING = 0;
+    }
+  });
+
+  return { vips, flush: () => flush() };
+}
+
+// Run in a fresh process, so that we measure a cold start.
+async function startupChild () {
+  const start = performance.now();
+  const { vips } = await loadVips();
+  const instantiate = performance.now() - start;
+
+  // the first call pays for lazy initialization, eg. of the type system
+  const firstCallStart = performance.now();
+  vips.Image.black(1, 1).avg();
+  const firstCall = performance.now() - firstCallStart;
+
+  vips.shutdown();
+
+  process.stdout.write(JSON.stringify({ instantiate, firstCall }));
+  process.exit(0);
+}
+
+function measureStartup (runs) {
+  const script = fileURLToPath(import.meta.url);
+  const samples = [];
+
+  for (let i = 0; i < runs; i++) {
+    const child = spawnSync(process.execPath, [script, '--startup-child'], {
+      encoding: 'utf8'
+    });
+    if (child.status !== 0) {
+      throw new Error(`startup run failed: ${child.stderr}`);
+    }
+    samples.push(JSON.parse(child.stdout));
+  }
+
+  const summarize = (key) => {
+    const values = samples.map((s) => s[key]);
+    return {
+      mean: values.reduce((a, b) => a + b, 0) / values.length,
+      min: Math.min(...values),
+      max: Math.max(...values)
+    };
+  };
+
+  return {
+    runs,
+    instantiate: summarize('instantiate'),
+    firstCall: summarize('firstCall')
+  };
+}
+
+// Small images for the per-operator benchmarks.
+function makeContext (vips) {
+  const im = vips.Image.newFromFile(inputJpg, { access: 'sequential' })
+    .thumbnailImage(64)
+    .copyMemory();
+  im.preventAutoDelete();
+
+  const mono = im.extractBand(0).copyMemory();
+  mono.preventAutoDelete();
+
+  const mask = vips.Image.newFromArray([
+    [-1, -1, -1],
+    [-1, 16, -1],
+    [-1, -1, -1]
+  ], 8);
+  mask.preventAutoDelete();
+
+  const lut = vips.Image.identity();
+  lut.preventAutoDelete();
+
+  return { im, mono, mask, lut };
+}
+
+// Operations are lazy, evaluate any image outputs to memory.
+function evaluate (vips, result) {
+  if (result instanceof vips.Image) {
+    result.copyMemory();
+  } else if (result !== null && typeof result === 'object') {
+    for (const value of Object.values(result)) {
+      if (value instanceof vips.Image) {
+        value.copyMemory();
+      }
+    }
+  }
+}
+
+function macroCases (vips) {
+  const jpg = vips.FS.readFile(inputJpg);
+  const png = vips.FS.readFile(inputPng);
+  const saveOptions = { keep: vips.ForeignKeep.none, Q: 80 };
+  const sharpen = vips.Image.newFromArray([
+    [-1, -1, -1],
+    [-1, 32, -1],
+    [-1, -1, -1]
+  ], 24);
+  sharpen.preventAutoDelete();
+
+  return [
+    {
+      name: 'resize',
+      fn: () => vips.Image.thumbnailBuffer(jpg, 720, { height: 10000000 })
+        .jpegsaveBuffer(saveOptions)
+    },
+    {
+      name: 'convolve',
+      fn: () => vips.Image.thumbnailBuffer(jpg, 720, { height: 10000000 })
+        .conv(sharpen)
+        .jpegsaveBuffer(saveOptions)
+    },
+    {
+      name: 'colourspace',
+      fn: () => vips.Image.thumbnailBuffer(jpg, 720, { height: 10000000 })
+        .colourspace('lab')
+        .colourspace('b-w')
+        .jpegsaveBuffer(saveOptions)
+    },
+    {
+      name: 'composite',
+      fn: () => {
+        const base = vips.Image.thumbnailBuffer(jpg, 720, { height: 10000000 });
+        const overlay = vips.Image.thumbnailBuffer(png, 360, { height: 10000000 });
+        base.composite2(overlay, 'over', { x: 100, y: 100 })
+          .jpegsaveBuffer(saveOptions);
+      }
+    },
+    {
+      name: 'histogram',
+      fn: () => vips.Image.thumbnailBuffer(jpg, 720, { height: 10000000 })
+        .histEqual()
+        .jpegsaveBuffer(saveOptions)
+    }
+  ];
+}
+
+function runGroup (vips, flush, group, cases, filter) {
+  const results = {};
+
+  for (const { name, fn } of cases) {
+    const key = `${group}/${name}`;
+    if (filter && !filter.test(key)) {
+      continue;
+    }
+
+    // Some generated cases can't run with synthetic arguments, record
+    // these rather than failing the whole suite.
+    try {
+      fn();
+      flush();
+    } catch (e) {
+      flush();
+      results[key] = { error: String(e.message ?? e) };
+      console.log(`${key} skipped: ${results[key].error}`);
+      continue;
+    }
+
+    const bench = new Benchmark(key, () => {
+      fn();
+      flush();
+    });
+    bench.run();
+
+    results[key] = {
+      hz: bench.hz,
+      mean: bench.stats.mean,
+      rme: bench.stats.rme,
+      samples: bench.stats.sample.length
+    };
+    console.log(String(bench));
+  }
+
+  return results;
+}
+
+async function run (args) {
+  const { vips, flush } = await loadVips();
+
+  // Disable libvips cache, we want to measure the work, not the cache
+  vips.Cache.max(0);
+  vips.concurrency(args.concurrency);
+
+  const results = {};
+
+  if (existsSync(new URL(operatorsModule, import.meta.url))) {
+    const { default: operators } = await import(operatorsModule);
+    const ctx = makeContext(vips);
+    const cases = operators.map(({ name, fn }) => ({
+      name,
+      fn: () => evaluate(vips, fn(vips, ctx))
+    }));
+    Object.assign(results, runGroup(vips, flush, 'micro', cases, args.filter));
+  } else {
+    console.warn('micro skipped: operators.js is missing, run `npm run suite` or ' +
+      'build/gen_bench_operators.py first');
+  }
+
+  Object.assign(results, runGroup(vips, flush, 'macro', macroCases(vips), args.filter));
+
+  const memory = {
+    highwater: vips.Stats.memHighwater(),
+    // reported in kilobytes
+    maxRSS: process.resourceUsage().maxRSS * 1024
+  };
+
+  const meta = {
+    date: new Date().toISOString(),
+    vips: vips.version(),
+    emscripten: vips.emscriptenVersion(),
+    node: process.version,
+    platform: `${os.platform()} ${os.arch()}`,
+    cpu: os.cpus()[0]?.model,
+    concurrency: vips.concurrency()
+  };
+
+  vips.shutdown();
+
+  const startup = args.startupRuns > 0 ? measureStartup(args.startupRuns) : null;
+  if (startup) {
+    console.log(`startup instantiate ${startup.instantiate.mean.toFixed(1)} ms, ` +
+      `first call ${startup.firstCall.mean.toFixed(1)} ms (${startup.runs} runs)`);
+  }
+  console.log(`memory highwater ${memory.highwater} bytes, max RSS ${memory.maxRSS} bytes`);
+
+  const report = { meta, results, startup, memory };
+  if (args.json) {
+    writeFileSync(args.json, JSON.stringify(report, null, 2));
+  }
+}
+
+// Lower is better for all compared metrics.
+function compare (baseFile, headFile, threshold) {
+  const base = JSON.parse(readFileSync(baseFile, 'utf8'));
+  const head = JSON.parse(readFileSync(headFile, 'utf8'));
+  const rows = [];
+
+  for (const [key, b] of Object.entries(base.results)) {
+    const h = head.results[key];
+    if (!h || b.error || h.error) {
+      continue;
+    }
+    // only flag changes that are larger than the measurement error
+    rows.push({ key, base: b.mean, head: h.mean, noise: b.rme + h.rme });
+  }
+
+  if (base.startup && head.startup) {
+    rows.push({
+      key: 'startup/instantiate',
+      base: base.startup.instantiate.mean,
+      head: head.startup.instantiate.mean,
+      noise: 0
+    });
+  }
+  rows.push({
+    key: 'memory/highwater',
+    base: base.memory.highwater,
+    head: head.memory.highwater,
+    noise: 0
+  });
+
+  let regressions = 0;
+  for (const { key, base: b, head: h, noise } of rows) {
+    const change = (h - b) / b * 100;
+    const regressed = change > threshold && change > noise;
+    if (regressed) {
+      regressions++;
+    }
+    console.log(`${regressed ? 'REGRESSION' : 'ok'.padEnd(10)} ${key.padEnd(40)} ` +
+      `${change >= 0 ? '+' : ''}${change.toFixed(1)}%`);
+  }
+
+  console.log(`${regressions} regression(s) above ${threshold}%`);
+  process.exitCode = regressions > 0 ? 1 : 0;
+}
+
+const args = parseArgs(process.argv.slice(2));
+
+if (args.startupChild) {
+  await startupChild();
+} else if (args.compare) {
+  compare(args.compare[0], args.compare[1], args.threshold);
+} else {
+  await run(args);
+}
@@ -0,0 +1,61 @@
+// Measure the throughput of temp files against memory images, see
+// tempfile.html. With a WasmFS build (`./build.sh --enable-wasm-fs`), temp
+// files are kept in the origin private file system (OPFS), unless `?tmp=memory`
+// is given, otherwise they're in memory.
+import Vips from '/lib/vips-es6.js';
+
+const log = (line) => postMessage(line);
+
+const params = new URLSearchParams(location.search);
+
+const vips = await Vips({
+  // Disable dynamic modules
+  dynamicLibraries: [],
+  opfsTmp: params.get('tmp') !== 'memory'
+});
+
+// We want to measure the I/O, not cache lookups
+vips.Cache.max(0);
+
+log(`temp files: ${vips.opfsTmp ? 'OPFS' : 'memory'}`);
+
+const bench = (name, bytes, fn) => {
+  // warm up
+  fn();
+
+  const runs = 5;
+  const start = performance.now();
+  for (let i = 0; i < runs; i++) {
+    fn();
+  }
+  const elapsed = (performance.now() - start) / runs;
+
+  const mbPerSec = bytes / (1024 * 1024) / (elapsed / 1000);
+  log(`${name.padEnd(40)} ${elapsed.toFixed(1).padStart(10)} ms ` +
+    `${mbPerSec.toFixed(1).padStart(10)} MB/s`);
+};
+
+for (const size of [2048, 4096, 8192]) {
+  const im = vips.scope(() => vips.Image.gaussnoise(size, size)
+    .cast('uchar')
+    .bandjoin([127, 255])
+    .copyMemory());
+  const bytes = size * size * 3;
+
+  // write the pixels and read them back
+  bench(`${size}x${size} memory image`, bytes, () => {
+    vips.scope(() => im.copyMemory().avg());
+  });
+  bench(`${size}x${size} temp file`, bytes, () => {
+    vips.scope(() => {
+      const t = vips.Image.newTempFile('%s.v');
+      im.write(t);
+      t.avg();
+    });
+  });
+
+  im.delete();
+}
+
+vips.shutdown();
+log('done');
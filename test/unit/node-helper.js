@@ -1,7 +1,10 @@
-import Vips from '../../lib/vips-node.mjs';
-
 import { expect } from 'chai';
 
+// Run against the wasm64 flavour with `VIPS_MEMORY64=1`, see `npm run test:wasm64`
+const { default: Vips } = await import(process.env.VIPS_MEMORY64
+  ? '../../lib/vips-node-wasm64.mjs'
+  : '../../lib/vips-node.mjs');
+
 globalThis.expect = expect;
 
 export async function mochaGlobalSetup () {
@@ -391,6 +391,38 @@ describe('arithmetic', () => {
     runUnary(allImages, invert, ['uchar']);
   });
 
+  it('typed array constants', () => {
+    const a = new Float64Array([1, 2, 3]);
+    const b = new Float64Array([2, 3, 4]);
+
+    let im = colour.linear(a, b);
+    Helpers.assertAlmostEqualObjects(im.getpoint(10, 10),
+      colour.linear([1, 2, 3], [2, 3, 4]).getpoint(10, 10));
+
+    im = colour.remainder(new Int32Array([2, 3, 4]));
+    Helpers.assertAlmostEqualObjects(im.getpoint(10, 10),
+      colour.remainder([2, 3, 4]).getpoint(10, 10));
+
+    im = colour.recomb(vips.Image.newMatrix(3, 3,
+      new Float64Array([1, 0, 0, 0, 1, 0, 0, 0, 1])));
+    Helpers.assertAlmostEqualObjects(im.getpoint(10, 10),
+      colour.getpoint(10, 10));
+
+    im = colour.recomb([[1, 0, 0], [0, 1, 0], [0, 0, 1]]);
+    Helpers.assertAlmostEqualObjects(im.getpoint(10, 10),
+      colour.getpoint(10, 10));
+
+    im = colour.and(new Float64Array([1, 2, 3]));
+    Helpers.assertAlmostEqualObjects(im.getpoint(10, 10),
+      colour.and([1, 2, 3]).getpoint(10, 10));
+
+    im = colour.more(new Int32Array([10, 20, 30]));
+    Helpers.assertAlmostEqualObjects(im.getpoint(10, 10),
+      colour.more([10, 20, 30]).getpoint(10, 10));
+
+    expect(() => vips.Image.newMatrix(2, 2, [1, 2, 3])).to.throw(/bad array length/);
+  });
+
   // test the rest of VipsArithmetic
 
   it('avg', () => {
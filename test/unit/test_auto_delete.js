@@ -17,13 +17,67 @@ describe('auto delete', () => {
     expect(vips.deletionQueue.length).to.equal(0);
   });
 
+  it('scope', () => {
+    const before = vips.Image.black(10, 10);
+    let kept;
+    let inner;
+
+    const result = vips.scope(() => {
+      const im = vips.Image.black(100, 100);
+      kept = im.invert().preventAutoDelete();
+
+      inner = vips.scope(() => im.flip('horizontal'));
+      expect(inner.isDeleted()).to.be.false;
+
+      return im.gaussblur(0.3);
+    });
+
+    // the result, the handles made before the scope and the ones we kept
+    // survive, the rest is deleted
+    expect(result.isDeleted()).to.be.false;
+    expect(before.isDeleted()).to.be.false;
+    expect(kept.isDeleted()).to.be.false;
+    expect(inner.isDeleted()).to.be.true;
+    expect(vips.deletionQueue).to.have.members([before, result]);
+
+    kept.delete();
+    cleanup();
+  });
+
+  it('scope keeps the handles in its result', () => {
+    const [a, b] = vips.scope(() => {
+      const im = vips.Image.black(10, 10);
+      return [im.invert(), im.flip('horizontal')];
+    });
+    expect(a.isDeleted()).to.be.false;
+    expect(b.isDeleted()).to.be.false;
+
+    const { left, right } = vips.scope(() => {
+      const im = vips.Image.black(10, 10);
+      return { left: im.crop(0, 0, 5, 10), right: im.crop(5, 0, 5, 10) };
+    });
+    expect(left.isDeleted()).to.be.false;
+    expect(right.isDeleted()).to.be.false;
+    expect(vips.deletionQueue).to.have.members([a, b, left, right]);
+
+    cleanup();
+  });
+
+  it('scope rejects async functions', () => {
+    let im;
+    expect(() => vips.scope(async () => {
+      im = vips.Image.black(10, 10);
+    })).to.throw(TypeError, /synchronous/);
+    expect(im.isDeleted()).to.be.true;
+  });
+
   describe('preventAutoDelete', () => {
     it('all handles', () => {
       const handles = Object.entries(vips).filter(
         ([key, Handle]) =>
           key !== 'Object' && !!Handle?.prototype?.preventAutoDelete
       );
-      expect(handles.length).to.equal(12);
+      expect(handles.length).to.equal(16);
 
       for (const [name] of handles) {
         const h = new vips[name]();
@@ -100,6 +100,165 @@ describe('connection', () => {
 
         vips.FS.close(stream);
       });
+      it('custom with read-ahead', () => {
+        const stream = vips.FS.open(Helpers.jpegFile, 'r');
+        const lengths = [];
+
+        const source = new vips.SourceCustom();
+        source.onRead = (length) => {
+          lengths.push(length);
+          const data = new Uint8Array(length);
+          const bytesRead = vips.FS.read(stream, data, 0, length);
+          return data.subarray(0, bytesRead);
+        };
+        source.onSeek = (offset, whence) =>
+          vips.FS.llseek(stream, offset, whence);
+        source.readAhead = 4096;
+        expect(source.readAhead).to.equal(4096);
+
+        const image = vips.Image.newFromSource(source, {
+          access: 'sequential'
+        });
+        const image2 = vips.Image.newFromFile(Helpers.jpegFile, {
+          access: 'sequential'
+        });
+
+        expect(image.subtract(image2).abs().max()).to.equal(0);
+
+        // the read handler is always asked for a whole window
+        const stats = source.stats();
+        expect(lengths.every((length) => length === 4096)).to.be.true;
+        expect(stats.fetches).to.equal(lengths.length);
+        expect(stats.bytesFetched).to.be.above(0);
+        expect(stats.stalls).to.be.at.least(1);
+        expect(stats.stallTime).to.be.at.least(0);
+
+        vips.FS.close(stream);
+      });
+      it('read-ahead with a throwing read handler', () => {
+        const source = new vips.SourceCustom();
+        source.onRead = () => {
+          throw new Error('network down');
+        };
+        source.readAhead = 4096;
+
+        // the read fails rather than waiting forever
+        expect(() => vips.Image.newFromSource(source)).to.throw();
+      });
+      it('ranges', function () {
+        // Needs TIFF support
+        if (!Helpers.have('tiffload_source') || !Helpers.have('tiffsave')) {
+          return this.skip();
+        }
+
+        const filename = vips.Utils.tempName('%s.tif');
+        const im = vips.Image.xyz(2048, 2048).extractBand(0).cast('uchar');
+        im.tiffsave(filename, { tile: true, tileWidth: 256, tileHeight: 256 });
+
+        // A stand-in for range requests over a local file
+        const stream = vips.FS.open(filename, 'r');
+        const size = vips.FS.stat(filename).size;
+        const ranges = [];
+        const source = vips.Source.newFromRanges((offset, length) => {
+          ranges.push([offset, length]);
+          const data = new Uint8Array(length);
+          vips.FS.read(stream, data, 0, length, offset);
+          return data;
+        }, size, { blockSize: 64 * 1024 });
+
+        const area = vips.Image.newFromSource(source)
+          .extractArea(300, 300, 100, 100);
+        expect(area.subtract(im.extractArea(300, 300, 100, 100)).abs().max())
+          .to.equal(0);
+
+        // only the blocks with the header, the IFD and a single tile were
+        // fetched, each of them once
+        const stats = source.stats();
+        expect(stats.fetches).to.equal(ranges.length);
+        expect(stats.bytesFetched).to.be.below(size / 4);
+        expect(new Set(ranges.map(([offset]) => offset)).size)
+          .to.equal(ranges.length);
+        expect(stats.mem).to.equal(stats.bytesFetched);
+        expect(stats.hitRatio).to.equal(stats.hits / (stats.hits + stats.misses));
+
+        vips.FS.close(stream);
+        vips.FS.unlink(filename);
+      });
+      it('custom beyond 2 GiB', function () {
+        // Needs TIFF source support
+        if (!Helpers.have('tiffload_source')) {
+          return this.skip();
+        }
+
+        // A 2x2 TIFF with its IFD and pixels at ~2.5 GiB, the bytes in
+        // between are never read
+        const base = 0xA0000000;
+        const count = 9;
+        const header = new DataView(new ArrayBuffer(8));
+        header.setUint16(0, 0x4949, true);
+        header.setUint16(2, 42, true);
+        header.setUint32(4, base, true);
+
+        const entries = [
+          [256, 3, 2], // ImageWidth
+          [257, 3, 2], // ImageLength
+          [258, 3, 8], // BitsPerSample
+          [259, 3, 1], // Compression
+          [262, 3, 1], // PhotometricInterpretation
+          [273, 4, base + 2 + count * 12 + 4], // StripOffsets
+          [277, 3, 1], // SamplesPerPixel
+          [278, 3, 2], // RowsPerStrip
+          [279, 4, 4] // StripByteCounts
+        ];
+        const ifd = new DataView(new ArrayBuffer(2 + count * 12 + 4 + 4));
+        ifd.setUint16(0, count, true);
+        entries.forEach(([tag, type, value], i) => {
+          ifd.setUint16(2 + i * 12, tag, true);
+          ifd.setUint16(4 + i * 12, type, true);
+          ifd.setUint32(6 + i * 12, 1, true);
+          if (type === 3) {
+            ifd.setUint16(10 + i * 12, value, true);
+          } else {
+            ifd.setUint32(10 + i * 12, value, true);
+          }
+        });
+        new Uint8Array(ifd.buffer).set([10, 20, 30, 40], ifd.byteLength - 4);
+
+        const size = base + ifd.byteLength;
+        const sections = [
+          [0, new Uint8Array(header.buffer)],
+          [base, new Uint8Array(ifd.buffer)]
+        ];
+        const offsets = [];
+        let position = 0;
+
+        const source = new vips.SourceCustom();
+        source.onRead = (length) => {
+          const data = new Uint8Array(Math.max(0, Math.min(length, size - position)));
+          for (const [start, bytes] of sections) {
+            const from = Math.max(start, position);
+            const to = Math.min(start + bytes.length, position + data.length);
+            if (from < to) {
+              data.set(bytes.subarray(from - start, to - start), from - position);
+            }
+          }
+          position += data.length;
+          return data;
+        };
+        source.onSeek = (offset, whence) => {
+          offsets.push(offset);
+          position = [0, position, size][whence] + offset;
+          return BigInt(position);
+        };
+
+        const image = vips.Image.newFromSource(source);
+
+        expect(image.width).to.equal(2);
+        expect(image.height).to.equal(2);
+        expect(image.getpoint(1, 1)).to.deep.equal([40]);
+        expect(image.avg()).to.equal(25);
+        expect(offsets.some((offset) => offset >= 2 ** 31)).to.be.true;
+      });
     });
     describe('writeToTarget', () => {
       it('file', () => {
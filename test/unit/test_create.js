@@ -227,6 +227,69 @@ describe('create', () => {
     expect(p[0]).to.equal(65535);
   });
 
+  it('newFromArray', () => {
+    let im = vips.Image.newFromArray([
+      [1, 2, 3],
+      [4, 5, 6]
+    ], 2, 1);
+    expect(im.width).to.equal(3);
+    expect(im.height).to.equal(2);
+    expect(im.getpoint(2, 1)[0]).to.equal(6);
+    expect(im.getDouble('scale')).to.equal(2);
+    expect(im.getDouble('offset')).to.equal(1);
+
+    im = vips.Image.newFromArray(new Float64Array([1, 2, 3, 4]));
+    expect(im.width).to.equal(4);
+    expect(im.height).to.equal(1);
+    expect(im.getpoint(3, 0)[0]).to.equal(4);
+
+    im = vips.Image.newMatrix(2, 2, new Float64Array([1, 2, 3, 4]));
+    expect(im.width).to.equal(2);
+    expect(im.height).to.equal(2);
+    expect(im.getpoint(0, 1)[0]).to.equal(3);
+  });
+
+  it('newFromMemory', () => {
+    // the same type is copied as is
+    let im = vips.Image.newFromMemory(new Float32Array([1.5, -2, 3, 4]), 2, 2, 1, 'float');
+    expect(im.getpoint(0, 0)[0]).to.equal(1.5);
+    expect(im.getpoint(1, 0)[0]).to.equal(-2);
+
+    // a different type of the same size has its values converted, rather
+    // than reinterpreted bit for bit
+    im = vips.Image.newFromMemory(new Float32Array([1, 2, 3, -4]), 2, 2, 1, 'int');
+    expect(im.format).to.equal('int');
+    expect(im.getpoint(1, 1)[0]).to.equal(-4);
+
+    im = vips.Image.newFromMemory(new Int32Array([1, 2, 3, -4]), 2, 2, 1, 'float');
+    expect(im.getpoint(1, 1)[0]).to.equal(-4);
+
+    im = vips.Image.newFromMemory(new Uint32Array([7, 8, 9, 10]), 2, 2, 1, 'int');
+    expect(im.avg()).to.equal(8.5);
+
+    // complex formats are not supported
+    expect(() => vips.Image.newFromMemory(new Float64Array(8), 2, 2, 1, 'complex'))
+      .to.throw(/band format unsupported/);
+  });
+
+  it('constant images', () => {
+    const im = vips.Image.black(16, 16, { bands: 3 });
+
+    // the constants are shared, so libvips can reuse the operation
+    im.ifthenelse([1, 2, 3], [4, 5, 6]);
+    let hits = vips.Cache.stats().hits;
+    im.ifthenelse([1, 2, 3], [4, 5, 6]);
+    expect(vips.Cache.stats().hits).to.equal(hits + 1);
+
+    // at most 32 constants are kept, the least recently used go first
+    for (let i = 0; i < 32; i++) {
+      im.ifthenelse([100 + i, 0, 0], im);
+    }
+    hits = vips.Cache.stats().hits;
+    im.ifthenelse([1, 2, 3], [4, 5, 6]);
+    expect(vips.Cache.stats().hits).to.equal(hits);
+  });
+
   it('invertlut', () => {
     const lut = vips.Image.newFromArray([
       [0.1, 0.2, 0.3, 0.1],
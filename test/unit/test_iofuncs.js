@@ -53,6 +53,94 @@ describe('iofuncs', () => {
     }).to.throw(/data type 'Uint8Array' is incompatible with band format 'ushort'/);
   });
 
+  it('newFromFileMapped', () => {
+    const filename = vips.Utils.tempName('%s.v');
+
+    const im = vips.Image.black(16, 8, { bands: 3 }).add([1, 2, 3]).cast('ushort').copy({ xres: 2 });
+    im.setString('wasm-vips-test', 'hello');
+    im.writeToFile(filename);
+
+    const mapped = vips.Image.newFromFileMapped(filename);
+    expect(mapped.width).to.equal(16);
+    expect(mapped.height).to.equal(8);
+    expect(mapped.bands).to.equal(3);
+    expect(mapped.format).to.equal('ushort');
+    expect(mapped.xres).to.equal(2);
+    expect(mapped.getString('wasm-vips-test')).to.equal('hello');
+    expect(mapped.getpoint(15, 7)).to.deep.equal([1, 2, 3]);
+    vips.FS.unlink(filename);
+
+    const rawFilename = vips.Utils.tempName('%s.raw');
+    im.rawsave(rawFilename);
+
+    const raw = vips.Image.newFromFileMapped(rawFilename, {
+      width: 16,
+      height: 8,
+      bands: 3,
+      format: 'ushort'
+    });
+    expect(raw.getpoint(0, 0)).to.deep.equal([1, 2, 3]);
+    expect(raw.equal(im).min()).to.equal(255);
+
+    // skip the first row
+    const offset = vips.Image.newFromFileMapped(rawFilename, {
+      width: 16,
+      height: 7,
+      bands: 3,
+      format: 'ushort',
+      offset: 16 * 3 * 2
+    });
+    expect(offset.avg()).to.equal(2);
+
+    // the file is too short for this layout
+    expect(() => vips.Image.newFromFileMapped(rawFilename, {
+      width: 16,
+      height: 9,
+      bands: 3,
+      format: 'ushort'
+    })).to.throw(/truncated/);
+
+    // bad layouts are rejected before anything is read
+    const layout = { width: 16, height: 8, bands: 3, format: 'ushort' };
+    expect(() => vips.Image.newFromFileMapped(rawFilename, { ...layout, width: 0 })).to.throw(/bad image layout/);
+    expect(() => vips.Image.newFromFileMapped(rawFilename, { ...layout, bands: -1 })).to.throw(/bad image layout/);
+    expect(() => vips.Image.newFromFileMapped(rawFilename, { ...layout, offset: -1 })).to.throw(/bad offset/);
+    expect(() => vips.Image.newFromFileMapped(rawFilename, {
+      ...layout,
+      width: 0x7fffffff,
+      height: 0x7fffffff
+    })).to.throw(/bad image layout/);
+    vips.FS.unlink(rawFilename);
+
+    // other formats are decoded as usual
+    const pngFilename = vips.Utils.tempName('%s.png');
+    im.cast('uchar').pngsave(pngFilename);
+    const png = vips.Image.newFromFileMapped(pngFilename);
+    expect(png.width).to.equal(16);
+    expect(png.getpoint(15, 7)).to.deep.equal([1, 2, 3]);
+    vips.FS.unlink(pngFilename);
+  });
+
+  it('newFromImageData', () => {
+    const data = Uint8ClampedArray.of(1, 2, 3, 255, 4, 5, 6, 128);
+    const im = vips.Image.newFromImageData({ data, width: 2, height: 1 });
+    expect(im.width).to.equal(2);
+    expect(im.height).to.equal(1);
+    expect(im.bands).to.equal(4);
+    expect(im.format).to.equal('uchar');
+    expect(im.getpoint(1, 0)).to.deep.equal([4, 5, 6, 128]);
+
+    // the pixels are copied, changes to the source are not seen
+    data[4] = 0;
+    expect(im.getpoint(1, 0)).to.deep.equal([4, 5, 6, 128]);
+
+    // a view on part of a buffer
+    const buffer = new Float32Array([0, 1, 2, 3, 4]);
+    const view = new Float32Array(buffer.buffer, 4, 4);
+    expect(Array.from(vips.Image.newFromMemory(view, 2, 2, 1, 'float').writeToMemory()))
+      .to.deep.equal([1, 2, 3, 4]);
+  });
+
   it('getFields', () => {
     const im = vips.Image.black(10, 10);
     const fields = im.getFields();
@@ -70,6 +158,131 @@ describe('iofuncs', () => {
     expect(s).to.deep.equal(t);
   });
 
+  it('strips', async () => {
+    const s = Uint8Array.from({ length: 300 }, (_, i) => i % 256);
+    const im = vips.Image.newFromMemory(s, 10, 10, 3, 'uchar');
+
+    const strips = [];
+    for await (const { top, height, data } of im.strips(4)) {
+      expect(data.length).to.equal(height * 10 * 3);
+      strips.push([top, height, Array.from(data)]);
+    }
+
+    expect(strips.map(([top, height]) => [top, height]))
+      .to.deep.equal([[0, 4], [4, 4], [8, 2]]);
+    expect(strips.flatMap(([, , data]) => data)).to.deep.equal(Array.from(s));
+
+    // leaving early stops the sink
+    for await (const { top } of im.strips(4)) {
+      expect(top).to.equal(0);
+      break;
+    }
+  });
+
+  it('toRGBA8', () => {
+    let im = vips.Image.newFromMemory(Uint8Array.of(10, 20), 2, 1, 1, 'uchar');
+    let t = im.toRGBA8();
+    expect(t).to.be.an.instanceof(Uint8ClampedArray);
+    expect(Array.from(t)).to.deep.equal([10, 10, 10, 255, 20, 20, 20, 255]);
+
+    im = vips.Image.newFromMemory(Uint8Array.of(1, 2, 3, 1, 2, 3), 2, 1, 3, 'uchar');
+    const dest = new Uint8ClampedArray(8);
+    t = im.toRGBA8(dest);
+    expect(t).to.equal(dest);
+    expect(Array.from(dest)).to.deep.equal([1, 2, 3, 255, 1, 2, 3, 255]);
+
+    expect(() => im.toRGBA8(new Uint8ClampedArray(4))).to.throw(/at least/);
+  });
+
+  it('frame pool', () => {
+    const pool = new vips.FramePool(4, 2, 1, 'uchar', 2).preventAutoDelete();
+    expect(pool.size).to.equal(8);
+    expect(pool.available).to.equal(2);
+
+    const ptr = pool.acquire();
+    pool.view(ptr).set([0, 1, 2, 3, 4, 5, 6, 7]);
+    let im = pool.image(ptr);
+    expect(Array.from(im.writeToMemory())).to.deep.equal([0, 1, 2, 3, 4, 5, 6, 7]);
+    expect(pool.available).to.equal(1);
+
+    // the buffer returns to the pool once the image is gone
+    cleanup();
+    expect(pool.available).to.equal(2);
+
+    im = vips.Image.black(4, 2).add(3).cast('uchar');
+    const out = pool.write(im);
+    expect(Array.from(pool.view(out))).to.deep.equal([3, 3, 3, 3, 3, 3, 3, 3]);
+    expect(pool.available).to.equal(1);
+    pool.release(out);
+    expect(pool.available).to.equal(2);
+
+    // buffers are wrapped at most once, and only after acquire()
+    const wrapped = pool.acquire();
+    im = pool.image(wrapped);
+    expect(() => pool.image(wrapped)).to.throw(/already wrapped/);
+    expect(() => pool.release(wrapped)).to.throw(/wrapped/);
+    cleanup();
+    expect(() => pool.image(wrapped)).to.throw(/not acquired/);
+    expect(() => pool.release(wrapped)).to.throw(/not acquired/);
+
+    pool.acquire();
+    pool.acquire();
+    expect(() => pool.acquire()).to.throw(/no free buffers/);
+    expect(() => pool.write(vips.Image.black(2, 2))).to.throw(/does not match/);
+
+    pool.delete();
+
+    // empty pools are rejected
+    expect(() => new vips.FramePool(0, 2, 1, 'uchar', 2)).to.throw(/must be positive/);
+    expect(() => new vips.FramePool(4, 0, 1, 'uchar', 2)).to.throw(/must be positive/);
+    expect(() => new vips.FramePool(4, 2, 0, 'uchar', 2)).to.throw(/must be positive/);
+    expect(() => new vips.FramePool(4, 2, 1, 'uchar', 0)).to.throw(/must be positive/);
+  });
+
+  it('frame pool and the operation cache', () => {
+    const pool = new vips.FramePool(4, 2, 1, 'uchar', 1).preventAutoDelete();
+
+    // the cached invert keeps the image alive
+    const ptr = pool.acquire();
+    pool.image(ptr).invert();
+    cleanup();
+    expect(pool.available).to.equal(0);
+
+    // ... until the pool runs out
+    expect(pool.acquire()).to.equal(ptr);
+    pool.release(ptr);
+    expect(pool.available).to.equal(1);
+
+    pool.delete();
+  });
+
+  it('region', () => {
+    const s = Float32Array.from({ length: 200 }, (_, i) => i);
+    const im = vips.Image.newFromMemory(s, 20, 10, 1, 'float');
+    const region = vips.Region.newFromImage(im);
+
+    let t = region.fetch(2, 3, 4, 2);
+    expect(t).to.be.an.instanceof(Float32Array);
+    expect(Array.from(t)).to.deep.equal([62, 63, 64, 65, 82, 83, 84, 85]);
+
+    // whole lines are copied in one go
+    t = region.fetch(0, 1, 20, 2);
+    expect(Array.from(t)).to.deep.equal(Array.from(s.subarray(20, 60)));
+
+    // clipped to the image
+    t = region.fetch(18, 9, 4, 4);
+    expect(Array.from(t)).to.deep.equal([198, 199]);
+
+    t = region.shrink(0, 0, 4, 4, 2);
+    expect(Array.from(t)).to.deep.equal([10.5, 12.5, 50.5, 52.5]);
+
+    t = region.shrink(0, 0, 4, 4, 4, 'max');
+    expect(Array.from(t)).to.deep.equal([63]);
+
+    expect(() => region.shrink(1, 0, 4, 4, 2)).to.throw(/multiple/);
+    expect(() => region.shrink(0, 0, 4, 4, 3)).to.throw(/power of two/);
+  });
+
   it('revalidate', () => {
     const filename = vips.Utils.tempName('%s.v');
 
@@ -101,4 +314,240 @@ describe('iofuncs', () => {
     load2.setDeleteOnClose(true);
     expect(load2.width).to.equal(im2.width);
   });
+
+  it('scheduler', async () => {
+    const scheduler = new vips.Scheduler(2, 100 * 100);
+    expect(scheduler.threads).to.equal(2);
+    expect(scheduler.pixelThreshold).to.equal(100 * 100);
+
+    const images = [
+      vips.Image.black(10, 10),
+      vips.Image.black(20, 20).add(128),
+      vips.Image.black(200, 200),
+      vips.Image.black(30, 30)
+    ];
+    const pending = scheduler.writeToBuffers(images, '.png');
+    expect(pending).to.be.an.instanceof(Promise);
+    const buffers = await pending;
+    expect(buffers.length).to.equal(images.length);
+
+    for (let i = 0; i < images.length; i++) {
+      const im = vips.Image.newFromBuffer(buffers[i]);
+      expect(im.width).to.equal(images[i].width);
+      expect(im.avg()).to.equal(images[i].avg());
+    }
+
+    const stats = scheduler.stats();
+    expect(stats.jobs).to.equal(4);
+    expect(stats.interImageJobs).to.equal(3);
+    expect(stats.intraImageJobs).to.equal(1);
+    expect(stats.threads).to.equal(2);
+    expect(stats.utilization).to.be.within(0, 1);
+
+    let error;
+    try {
+      await scheduler.writeToBuffers([images[0], 42], '.png');
+    } catch (e) {
+      error = e;
+    }
+    expect(error).to.match(/element 1 is not an image/);
+  });
+
+  it('result cache', () => {
+    const buf = vips.Image.black(100, 100).add(42).writeToBuffer('.png');
+
+    vips.Cache.resultClear();
+    vips.Cache.resultMaxMem(1024 * 1024);
+    expect(vips.Cache.resultMaxMem()).to.equal(1024 * 1024);
+
+    try {
+      const thumbnail = () => vips.Image.newFromBuffer(buf).resize(0.5);
+
+      const first = thumbnail().writeToBuffer('.jpg', { Q: 80, strip: true });
+      let stats = vips.Cache.resultStats();
+      expect(stats.misses).to.equal(1);
+      expect(stats.hits).to.equal(0);
+      expect(stats.entries).to.equal(1);
+      expect(stats.mem).to.equal(first.length);
+
+      // same input, chain and options, but in another order
+      const second = thumbnail().writeToBuffer('.jpg', { strip: true, Q: 80 });
+      expect(second).to.deep.equal(first);
+      expect(vips.Cache.resultStats().hits).to.equal(1);
+
+      // different save options
+      thumbnail().writeToBuffer('.jpg', { Q: 90 });
+      expect(vips.Cache.resultStats().misses).to.equal(2);
+
+      // changed metadata
+      const im = thumbnail().copy();
+      im.setString('test', 'hello');
+      im.writeToBuffer('.jpg', { Q: 80, strip: true });
+      expect(vips.Cache.resultStats().misses).to.equal(3);
+
+      // backing store
+      const store = new Map();
+      vips.Cache.resultStore(store);
+      vips.Cache.resultClear();
+      thumbnail().writeToBuffer('.png');
+      expect(store.size).to.equal(1);
+
+      vips.Cache.resultClear();
+      thumbnail().writeToBuffer('.png');
+      stats = vips.Cache.resultStats();
+      expect(stats.hits).to.equal(1);
+      expect(stats.misses).to.equal(0);
+    } finally {
+      vips.Cache.resultStore(null);
+      vips.Cache.resultMaxMem(0);
+      vips.Cache.resultClear();
+    }
+    expect(vips.Cache.resultStats().entries).to.equal(0);
+  });
+
+  it('decode cache', () => {
+    const buf = vips.Image.black(100, 100).add(42).writeToBuffer('.png');
+    const dir = vips.Utils.tempName('%s');
+
+    vips.Cache.decodeDir(dir);
+    expect(vips.Cache.decodeDir()).to.equal(dir);
+
+    try {
+      const first = vips.Image.newFromBuffer(buf);
+      expect(first.avg()).to.equal(42);
+      let stats = vips.Cache.decodeStats();
+      expect(stats.misses).to.equal(1);
+      expect(stats.hits).to.equal(0);
+      expect(stats.entries).to.equal(1);
+      expect(stats.size).to.be.above(100 * 100);
+
+      // reopened from disc
+      const second = vips.Image.newFromBuffer(buf);
+      expect(second.avg()).to.equal(42);
+      expect(vips.Cache.decodeStats().hits).to.equal(1);
+
+      // different load options
+      vips.Image.newFromBuffer(buf, '', { access: 'sequential' });
+      stats = vips.Cache.decodeStats();
+      expect(stats.misses).to.equal(2);
+      expect(stats.entries).to.equal(2);
+
+      // the next run picks up the cached images
+      vips.Cache.decodeDir(dir);
+      expect(vips.Cache.decodeStats().entries).to.equal(2);
+
+      // shrinking the cap evicts the least-recently used image
+      vips.Cache.decodeMaxSize(stats.size * 0.75);
+      stats = vips.Cache.decodeStats();
+      expect(stats.entries).to.equal(1);
+      expect(stats.evictions).to.equal(1);
+
+      // images cached by another process count towards the cap
+      vips.Image.black(10, 10).vipssave(`${dir}/${'a'.repeat(64)}.v`);
+      vips.Cache.decodeMaxSize(1024 * 1024 * 1024);
+      expect(vips.Cache.decodeStats().entries).to.equal(2);
+
+      // partial files left over by a process that stopped halfway are
+      // removed, those still being written are not
+      const stale = `${dir}/${'b'.repeat(64)}-1.partial.v`;
+      const fresh = `${dir}/${'c'.repeat(64)}-2.partial.v`;
+      vips.FS.writeFile(stale, 'stale');
+      vips.FS.writeFile(fresh, 'fresh');
+      const old = Date.now() - 2 * 60 * 60 * 1000;
+      vips.FS.utime(stale, old, old);
+      vips.Cache.decodeDir(dir);
+      expect(vips.FS.readdir(dir)).to.not.include(stale.split('/').pop());
+      expect(vips.FS.readdir(dir)).to.include(fresh.split('/').pop());
+      vips.FS.unlink(fresh);
+    } finally {
+      vips.Cache.decodeClear();
+      vips.Cache.decodeMaxSize(1024 * 1024 * 1024);
+      vips.Cache.decodeDir('');
+      vips.FS.rmdir(dir);
+    }
+    expect(vips.Cache.decodeStats().entries).to.equal(0);
+  });
+
+  it('operation cache', () => {
+    const before = vips.Cache.stats();
+
+    const im = vips.Image.black(123, 45);
+    im.invert();
+    im.invert(); // reuses the cached operation
+
+    let stats = vips.Cache.stats();
+    expect(stats.hits - before.hits).to.be.at.least(1);
+    expect(stats.operations.invert).to.be.at.least(1);
+    expect(stats.oldestAge).to.be.at.least(0);
+    expect(stats.mem).to.be.above(0);
+
+    expect(vips.Cache.drop('invert')).to.be.at.least(1);
+    expect(vips.Cache.stats().operations.invert).to.be.undefined;
+
+    im.flip('horizontal');
+    expect(vips.Cache.drop((entry) => entry.nickname === 'flip')).to.be.at.least(1);
+    stats = vips.Cache.stats();
+    expect(stats.operations.flip).to.be.undefined;
+    expect(stats.evictions - before.evictions).to.be.at.least(2);
+
+    vips.Cache.trimTrackedMem(0);
+    expect(vips.Cache.size()).to.equal(0);
+
+    // operations libvips doesn't keep are not evictions
+    const max = vips.Cache.max();
+    const adaptive = vips.Cache.adaptive();
+    try {
+      vips.Cache.max(0);
+      const evictions = vips.Cache.stats().evictions;
+      vips.Image.black(12, 34).invert().delete();
+      expect(vips.Cache.stats().evictions).to.equal(evictions);
+    } finally {
+      vips.Cache.max(max);
+      vips.Cache.adaptive(adaptive);
+    }
+  });
+
+  it('adaptive cache', () => {
+    const max = vips.Cache.max();
+    const maxMem = vips.Cache.maxMem();
+
+    try {
+      vips.Cache.adaptive(true);
+      expect(vips.Cache.adaptive()).to.be.true;
+      expect(vips.Cache.memoryCeiling()).to.be.above(0);
+      expect(vips.Cache.maxMem()).to.be.at.most(vips.Cache.memoryCeiling() / 5);
+      expect(vips.Cache.max()).to.be.within(0, 100);
+
+      // explicit limits disable the adaptive sizing
+      vips.Cache.maxMem(1024 * 1024);
+      expect(vips.Cache.adaptive()).to.be.false;
+      vips.Image.black(10, 10).invert();
+      expect(vips.Cache.maxMem()).to.equal(1024 * 1024);
+    } finally {
+      vips.Cache.max(max);
+      vips.Cache.maxMem(maxMem);
+      vips.Cache.adaptive(true);
+    }
+  });
+
+  it('beyond 4 GiB', function () {
+    // Needs the wasm64 flavour, see `npm run test:wasm64`
+    if (!vips.memory64) {
+      return this.skip();
+    }
+
+    // 40000 x 40000 x 3 bytes is ~4.5 GiB of pixels
+    const im = vips.Image.black(40000, 40000, { bands: 3 }).copyMemory();
+    im.drawRect([1, 2, 3], 39999, 39999, 1, 1, { fill: true });
+    expect(im.getpoint(39999, 39999)).to.deep.equal([1, 2, 3]);
+    expect(im.getpoint(0, 0)).to.deep.equal([0, 0, 0]);
+
+    // the last pixel is beyond 4 GiB in the buffer, check that a region
+    // reads it back from there
+    const region = vips.Region.newFromImage(im);
+    const pixels = region.fetch(39998, 39999, 2, 1);
+    expect(Array.from(pixels)).to.deep.equal([0, 0, 0, 1, 2, 3]);
+
+    expect(im.max()).to.equal(3);
+  });
 });